@@ -0,0 +1,214 @@
+//  Timing of the SpMV kernels on generated matrices
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "utils.hpp"  // matrix and vector interfaces are included here
+
+// best-of time in milliseconds of one kernel, f(A, x, y) runs it
+template <class F>
+double time_mv(F f, const csr::CSRMatrix &A, const vec::DenseVec &x,
+               vec::DenseVec &y, const int reps) {
+  typedef std::chrono::steady_clock clock;
+  f(A, x, y);  // warm up
+  double best = 1e300;
+  for (int r = 0; r < reps; ++r) {
+    const clock::time_point t0 = clock::now();
+    f(A, x, y);
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(clock::now() - t0)
+                  .count());
+  }
+  return best;
+}
+
+// power-law row lengths, P(len) ~ len^-alpha, plus one row of length n
+csr::CSRMatrix *power_law(const int n, const double alpha, std::mt19937 &rng) {
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  std::vector<int> lens(n);
+  long nnz = 0;
+  for (int i = 0; i < n; ++i) {
+    // inverse transform sampling of a Pareto law starting at 1
+    const double len = std::pow(1.0 - u(rng), -1.0 / (alpha - 1.0));
+    lens[i] = int(std::min(double(n), len));
+    nnz += lens[i];
+  }
+  lens[n / 2] = n;
+  nnz += n;
+
+  csr::CSRMatrix *A = csr::create(n, int(nnz));
+  std::uniform_int_distribution<int> col(0, n - 1);
+  std::vector<int> cols;
+  std::vector<double> vals;
+  for (int i = 0; i < n; ++i) {
+    cols.resize(lens[i]);
+    vals.assign(lens[i], 1.0);
+    for (int k = 0; k < lens[i]; ++k) cols[k] = lens[i] == n ? k : col(rng);
+    csr::assign_row(*A, i, cols.data(), vals.data(), lens[i]);
+  }
+  return A;
+}
+
+// diagonally dominant band matrix with nnz_row entries per row
+csr::CSRMatrix *band(const int n, const int nnz_row, std::mt19937 &rng) {
+  csr::CSRMatrix *A = csr::create(n, n * nnz_row);
+  std::uniform_real_distribution<double> val(-1.0, 1.0);
+  std::vector<int> cols(nnz_row);
+  std::vector<double> vals(nnz_row);
+  for (int i = 0; i < n; ++i) {
+    const int first = std::min(std::max(0, i - nnz_row / 2), n - nnz_row);
+    double sum = 1.0;
+    for (int k = 0; k < nnz_row; ++k) {
+      cols[k] = first + k;
+      vals[k] = val(rng);
+      sum += std::abs(vals[k]);
+    }
+    vals[i - first] = sum;
+    csr::assign_row(*A, i, cols.data(), vals.data(), nnz_row);
+  }
+  return A;
+}
+
+// time-to-solution in milliseconds of the refinement, in mixed or double
+double time_solve(const mpir::Solver &s, const vec::DenseVec &b,
+                  vec::DenseVec &x, const bool mixed, mpir::Info &info) {
+  typedef std::chrono::steady_clock clock;
+  for (int i = 0; i < x.n; ++i) x.value[i] = 0.0;
+  const clock::time_point t0 = clock::now();
+  mpir::solve(s, b, x, 1e-14, info, mixed);
+  return std::chrono::duration<double, std::milli>(clock::now() - t0)
+      .count();
+}
+
+// latencies in milliseconds of products issued by concurrent clients, each
+// client alternates small and large products; pooled=false runs csr::mv on
+// the calling thread instead of the shared pool
+double serve(csr::CSRMatrix *const *mats, const int nclients, const int nreq,
+             const bool pooled, std::vector<double> &small) {
+  typedef std::chrono::steady_clock clock;
+  std::vector<std::vector<double> > lat(nclients);
+  std::vector<std::thread> clients;
+  const clock::time_point t0 = clock::now();
+  for (int c = 0; c < nclients; ++c) {
+    clients.push_back(std::thread([&, c]() {
+      vec::DenseVec *xs[2], *ys[2];
+      for (int m = 0; m < 2; ++m) {
+        xs[m] = vec::create(mats[m]->n);
+        ys[m] = vec::create(mats[m]->n);
+        for (int i = 0; i < mats[m]->n; ++i) xs[m]->value[i] = 1.0;
+      }
+      for (int r = 0; r < nreq; ++r) {
+        // one large product per 8 small ones
+        const int m = (r + c) % 8 == 0 ? 1 : 0;
+        const clock::time_point t = clock::now();
+        if (pooled) {
+          pool::mv(*mats[m], *xs[m], *ys[m]);
+        } else {
+          csr::mv(*mats[m], *xs[m], *ys[m]);
+        }
+        if (m == 0) {
+          lat[c].push_back(std::chrono::duration<double, std::milli>(
+                               clock::now() - t)
+                               .count());
+        }
+      }
+      for (int m = 0; m < 2; ++m) {
+        vec::destroy(xs[m]);
+        vec::destroy(ys[m]);
+      }
+    }));
+  }
+  for (int c = 0; c < nclients; ++c) clients[c].join();
+  const double total =
+      std::chrono::duration<double>(clock::now() - t0).count();
+  small.clear();
+  for (int c = 0; c < nclients; ++c) {
+    small.insert(small.end(), lat[c].begin(), lat[c].end());
+  }
+  std::sort(small.begin(), small.end());
+  return double(nclients) * nreq / total;
+}
+
+int main() {
+  std::mt19937 rng(562);
+  const int n = 200000;
+  const double alphas[] = {3.0, 2.2, 2.0};
+
+  for (unsigned c = 0; c < sizeof(alphas) / sizeof(alphas[0]); ++c) {
+    csr::CSRMatrix *A = power_law(n, alphas[c], rng);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y = vec::create(n);
+    for (int i = 0; i < n; ++i) x->value[i] = 1.0;
+
+    std::cout << "power-law alpha=" << alphas[c] << ", n=" << n
+              << ", nnz=" << A->indptr[n] << '\n';
+    std::cout << "\tmv          " << time_mv(csr::mv<std::int32_t>, *A, *x, *y, 10)
+              << " ms\n";
+    std::cout << "\tmv_merge    " << time_mv(csr::mv_merge, *A, *x, *y, 10)
+              << " ms\n";
+    // bins are built once, as a tuned plan would
+    csr::RowBins *bins = csr::bin_rows(*A);
+    std::cout << "\tmv_adaptive "
+              << time_mv([bins](const csr::CSRMatrix &A,
+                                const vec::DenseVec &x, vec::DenseVec &y) {
+                   return csr::mv_adaptive(A, *bins, x, y);
+                 }, *A, *x, *y, 10)
+              << " ms\n";
+    csr::destroy(bins);
+
+    vec::destroy(x);
+    vec::destroy(y);
+    csr::destroy(A);
+  }
+
+  {
+    const int nb = 1000000, nnz_row = 16;
+    csr::CSRMatrix *A = band(nb, nnz_row, rng);
+    vec::DenseVec *b = vec::create(nb);
+    vec::DenseVec *x = vec::create(nb);
+    for (int i = 0; i < nb; ++i) x->value[i] = std::sin(0.01 * i);
+    csr::mv(*A, *x, *b);
+    mpir::Solver *s = mpir::create(*A);
+    mpir::Info info;
+
+    std::cout << "refinement band, n=" << nb << ", nnz=" << A->indptr[nb]
+              << '\n';
+    const char *names[] = {"\tmixed  ", "\tdouble "};
+    for (int c = 0; c < 2; ++c) {
+      const double t = time_solve(*s, *b, *x, c == 0, info);
+      std::cout << names[c] << t << " ms, " << info.outer << " steps, "
+                << info.inner << " inner iterations, residual "
+                << info.residual << '\n';
+    }
+
+    mpir::destroy(s);
+    vec::destroy(b);
+    vec::destroy(x);
+    csr::destroy(A);
+  }
+
+  {
+    const int nt = std::max(1u, std::thread::hardware_concurrency());
+    const int nclients = 4 * nt, nreq = 200;
+    csr::CSRMatrix *mats[2] = {band(2000, 8, rng), band(200000, 16, rng)};
+    std::vector<double> small;
+
+    std::cout << "pool, " << nclients << " clients, " << nreq
+              << " products each, small n=2000, large n=200000\n";
+    const char *names[] = {"\tcaller  ", "\tpool    "};
+    for (int c = 0; c < 2; ++c) {
+      const double rate = serve(mats, nclients, nreq, c == 1, small);
+      std::cout << names[c] << rate << " products/s, small p50 "
+                << small[small.size() / 2] << " ms, p99 "
+                << small[small.size() * 99 / 100] << " ms\n";
+    }
+
+    csr::destroy(mats[0]);
+    csr::destroy(mats[1]);
+  }
+  return 0;
+}
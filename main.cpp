@@ -1,6 +1,13 @@
 //  The main test program
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <thread>
 
 #include "utils.hpp"  // matrix and vector interfaces are included here
 
@@ -17,6 +24,78 @@ double nrm2_error(const vec::DenseVec &x, const vec::DenseVec &x_ref) {
   return std::sqrt(e / r);
 }
 
+// random diagonally dominant matrix with about nnz_row entries per row,
+// bandwidth 1 gives a tridiagonal matrix
+csr::CSRMatrix *generate(const int n, const int nnz_row, const int bandwidth,
+                         std::mt19937 &rng) {
+  csr::CSRMatrix *A = csr::create(n, n * nnz_row);
+  std::uniform_real_distribution<double> val(-1.0, 1.0);
+  std::uniform_int_distribution<int> off(-bandwidth, bandwidth);
+  std::vector<int> cols;
+  std::vector<double> vals;
+  for (int i = 0; i < n; ++i) {
+    cols.assign(1, i);
+    for (int k = 1; k < nnz_row; ++k) {
+      const int j = i + off(rng);
+      if (j < 0 || j >= n) continue;
+      if (std::find(cols.begin(), cols.end(), j) != cols.end()) continue;
+      cols.push_back(j);
+    }
+    std::sort(cols.begin(), cols.end());
+    vals.resize(cols.size());
+    double sum = 1.0;
+    for (unsigned k = 0; k < cols.size(); ++k) {
+      vals[k] = val(rng);
+      sum += std::abs(vals[k]);
+    }
+    for (unsigned k = 0; k < cols.size(); ++k) {
+      if (cols[k] == i) vals[k] = sum;
+    }
+    csr::assign_row(*A, i, cols.data(), vals.data(), cols.size());
+  }
+  return A;
+}
+
+// serial reference of the triangular sweeps, lower=true solves with the
+// lower part; old=nullptr ignores the other part (triangular solve)
+void sweep_ref(const csr::CSRMatrix &A, const bool lower, const double *b,
+               double *x, const double *old) {
+  for (int p = 0; p < A.n; ++p) {
+    const int i = lower ? p : A.n - 1 - p;
+    double sum = b[i], d = 0.0;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      const int j = A.indices[k];
+      if (j == i) {
+        d = A.value[k];
+      } else if (lower ? j < i : j > i) {
+        sum -= A.value[k] * x[j];
+      } else if (old) {
+        sum -= A.value[k] * old[j];
+      }
+    }
+    x[i] = sum / d;
+  }
+}
+
+// copy of A with the entries j-i <= max_off, ones=true sets the values to 1
+csr::CSRMatrix *copy(const csr::CSRMatrix &A, const int max_off,
+                     const bool ones) {
+  csr::CSRMatrix *B = csr::create(A.n, A.indptr[A.n]);
+  std::vector<int> cols;
+  std::vector<double> vals;
+  for (int i = 0; i < A.n; ++i) {
+    cols.clear();
+    vals.clear();
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      if (A.indices[k] - i > max_off) continue;
+      cols.push_back(A.indices[k]);
+      vals.push_back(ones ? 1.0 : A.value[k]);
+    }
+    csr::assign_row(*B, i, cols.data(), vals.data(), cols.size());
+  }
+  return B;
+}
+
 int main() {
   for (int i = 0; i < 2; ++i) {
     // define our files
@@ -72,6 +151,25 @@ int main() {
     std::cerr << " CSR mv test for case " << i + 1 << ", relative error is "
               << err << '\n';
 
+    std::cout << "\tcomputing y=Ax with merge-path and adaptive kernels...\n";
+    if (csr::mv_merge(*csr, *x, *buf)) {
+      std::cerr << "error occured in CSR mv_merge for case " << i + 1 << '\n';
+      return 1;
+    }
+    err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " CSR mv_merge test for case " << i + 1
+              << ", relative error is " << err << '\n';
+    if (csr::mv_adaptive(*csr, *x, *buf)) {
+      std::cerr << "error occured in CSR mv_adaptive for case " << i + 1
+                << '\n';
+      return 1;
+    }
+    err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " CSR mv_adaptive test for case " << i + 1
+              << ", relative error is " << err << '\n';
+
     std::cout << "\textracting diagonal of CSR...\n";
     if (csr::extract_diag(*csr, *buf)) {
       std::cerr << "error occured in CSR extract_diag for case " << i + 1
@@ -129,6 +227,81 @@ int main() {
     std::cerr << " COO extract_diag test for case " << i + 1
               << ", relative error is " << err << "\n\n";
 
+    std::cout << "\tloading 64-bit CSR and COO matrices...\n";
+    std::int64_t n64, nnz64;
+    utils::load_mat_sizes(mat_file, n64, nnz64);
+    csr::CSRMatrix64 *csr64 = csr::create(n64, nnz64);
+    coo::COOMatrix64 *coo64 = coo::create(n64, nnz64);
+    vec::DenseVec64 *x64 = vec::create(n64);
+    vec::DenseVec64 *buf64 = vec::create(n64);
+    if (!csr64 || !coo64) {
+      std::cerr << "cannot create 64-bit matrices for case " << i + 1 << '\n';
+      return 1;
+    }
+    utils::load_csr(mat_file, *csr64);
+    utils::load_coo(mat_file, *coo64);
+    utils::load_vec(x_file, *x64);
+
+    std::cout << "\tcomputing y=Ax...\n";
+    if (csr::mv(*csr64, *x64, *buf64)) {
+      std::cerr << "error occured in 64-bit CSR mv for case " << i + 1 << '\n';
+      return 1;
+    }
+    std::copy(buf64->value, buf64->value + n, buf->value);
+    err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " 64-bit CSR mv test for case " << i + 1
+              << ", relative error is " << err << '\n';
+    if (coo::mv(*coo64, *x64, *buf64)) {
+      std::cerr << "error occured in 64-bit COO mv for case " << i + 1 << '\n';
+      return 1;
+    }
+    std::copy(buf64->value, buf64->value + n, buf->value);
+    err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " 64-bit COO mv test for case " << i + 1
+              << ", relative error is " << err << '\n';
+    if (csr::extract_diag(*csr64, *buf64)) {
+      std::cerr << "error occured in 64-bit CSR extract_diag for case "
+                << i + 1 << '\n';
+      return 1;
+    }
+    std::copy(buf64->value, buf64->value + n, buf->value);
+    err = nrm2_error(*buf, *diag_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " 64-bit CSR extract_diag test for case " << i + 1
+              << ", relative error is " << err << "\n\n";
+
+    csr::destroy(csr64);
+    coo::destroy(coo64);
+    vec::destroy(x64);
+    vec::destroy(buf64);
+
+    std::cout << "\ttuning CSR matrix...\n";
+    tune::Plan *plan = tune::create(*csr, nullptr);
+    if (!plan) {
+      std::cerr << "cannot tune CSR for case " << i + 1 << '\n';
+      return 1;
+    }
+    std::cout << "\tselected kernel " << tune::kernel_name(*plan) << " with "
+              << tune::threads(*plan) << " thread(s)\n";
+
+    std::cout << "\tcomputing y=Ax...\n";
+    if (tune::mv(*plan, *x, *buf)) {
+      std::cerr << "error occured in tuned mv for case " << i + 1 << '\n';
+      return 1;
+    }
+
+    std::cout << "\tanalyzing the error...\n";
+    err = nrm2_error(*buf, *y_ref);
+    if (err > 1e-12) {
+      std::cerr << '\t' << FAIL;
+    } else {
+      std::cerr << '\t' << PASS;
+    }
+    std::cerr << " tuned mv test for case " << i + 1 << ", relative error is "
+              << err << "\n\n";
+
     std::cout << "\trelaxing memory...\n";
 
     // free memory
@@ -138,8 +311,678 @@ int main() {
     vec::destroy(buf);
 
     // matrices
+    tune::destroy(plan);
     csr::destroy(csr);
     coo::destroy(coo);
   }
+
+  {
+    // 5-point Laplacian on a 16x16 grid, stored as general CSR
+    const int nx = 16, n = nx * nx;
+    std::cout << "\nstencil case\n";
+
+    csr::CSRMatrix *csr = csr::create(n, 5 * n);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    for (int r = 0; r < n; ++r) {
+      int cols[5], k = 0;
+      double vals[5];
+      const int ix = r % nx, iy = r / nx;
+      if (iy > 0) cols[k] = r - nx, vals[k++] = -1.0;
+      if (ix > 0) cols[k] = r - 1, vals[k++] = -1.0;
+      cols[k] = r, vals[k++] = 4.0;
+      if (ix < nx - 1) cols[k] = r + 1, vals[k++] = -1.0;
+      if (iy < nx - 1) cols[k] = r + nx, vals[k++] = -1.0;
+      csr::assign_row(*csr, r, cols, vals, k);
+      x->value[r] = std::sin(0.1 * r);
+    }
+    csr::mv(*csr, *x, *y_ref);
+
+    std::vector<int> offsets;
+    stencil::detect_offsets(*csr, offsets);
+    std::cout << "\tdetected " << offsets.size() << " diagonal offsets\n";
+
+    tune::Stats st;
+    const bool found = !tune::analyze(*csr, st) && st.symmetric &&
+                       st.bandwidth == nx && st.block_size == 1;
+    std::cerr << '\t' << (found ? PASS : FAIL)
+              << " stencil analysis test, bandwidth " << st.bandwidth
+              << ", block size " << st.block_size << '\n';
+
+    std::cout << "\tconverting CSR to 5-point stencil...\n";
+    typedef stencil::Stencil5<nx> Stencil;
+    Stencil *sten = stencil::from_csr<Stencil>(*csr);
+    if (!sten || offsets.size() != 5) {
+      std::cerr << "cannot convert stencil CSR\n";
+      return 1;
+    }
+
+    std::cout << "\tcomputing y=Ax...\n";
+    if (stencil::mv(*sten, *x, *buf)) {
+      std::cerr << "error occured in stencil mv\n";
+      return 1;
+    }
+
+    std::cout << "\tanalyzing the error...\n";
+    const double err = nrm2_error(*buf, *y_ref);
+    if (err > 1e-12) {
+      std::cerr << '\t' << FAIL;
+    } else {
+      std::cerr << '\t' << PASS;
+    }
+    std::cerr << " stencil mv test, relative error is " << err << "\n\n";
+
+    std::cout << "\trelaxing memory...\n";
+    stencil::destroy(sten);
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(csr);
+  }
+
+  {
+    // 7- and 27-point operators on a 5x4x3 grid, stored as general CSR
+    const int nx = 5, ny = 4, nz = 3, n = nx * ny * nz;
+    std::cout << "\n3D stencil case\n";
+
+    csr::CSRMatrix *csr[2];
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    for (int c = 0; c < 2; ++c) {
+      // c = 0 keeps the face neighbors only, c = 1 all 26 neighbors
+      csr[c] = csr::create(n, 27 * n);
+      for (int r = 0; r < n; ++r) {
+        int cols[27], k = 0;
+        double vals[27];
+        const int ix = r % nx, iy = r / nx % ny, iz = r / (nx * ny);
+        for (int dz = -1; dz <= 1; ++dz) {
+          for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+              const int d = std::abs(dx) + std::abs(dy) + std::abs(dz);
+              if ((c == 0 && d > 1) || ix + dx < 0 || ix + dx >= nx ||
+                  iy + dy < 0 || iy + dy >= ny || iz + dz < 0 ||
+                  iz + dz >= nz) {
+                continue;
+              }
+              cols[k] = r + dx + nx * (dy + ny * dz);
+              vals[k++] = d ? -1.0 : (c ? 26.0 : 6.0);
+            }
+          }
+        }
+        csr::assign_row(*csr[c], r, cols, vals, k);
+        x->value[r] = std::sin(0.1 * r);
+      }
+    }
+
+    std::vector<int> off7, off27;
+    stencil::detect_offsets(*csr[0], off7);
+    stencil::detect_offsets(*csr[1], off27);
+    std::cout << "\tdetected " << off7.size() << " and " << off27.size()
+              << " diagonal offsets\n";
+
+    std::cout << "\tconverting CSR to 7- and 27-point stencils...\n";
+    typedef stencil::Stencil7<nx, ny> S7;
+    typedef stencil::Stencil27<nx, ny> S27;
+    S7 *s7 = stencil::from_csr<S7>(*csr[0]);
+    S27 *s27 = stencil::from_csr<S27>(*csr[1]);
+    S7 *wrong = stencil::from_csr<S7>(*csr[1]);
+    const bool fits = s7 && s27 && !wrong && off7.size() == 7 &&
+                      off27.size() == 27;
+    std::cerr << '\t' << (fits ? PASS : FAIL)
+              << " 3D stencil offsets test, 27-point matrix "
+              << (wrong ? "accepted" : "rejected") << " as 7-point\n";
+    if (!s7 || !s27) {
+      std::cerr << "cannot convert stencil CSR\n";
+      return 1;
+    }
+
+    std::cout << "\tcomputing y=Ax...\n";
+    const char *names[] = {"7-point", "27-point"};
+    for (int c = 0; c < 2; ++c) {
+      csr::mv(*csr[c], *x, *y_ref);
+      if (c ? stencil::mv(*s27, *x, *buf) : stencil::mv(*s7, *x, *buf)) {
+        std::cerr << "error occured in stencil mv\n";
+        return 1;
+      }
+      const double err = nrm2_error(*buf, *y_ref);
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << ' ' << names[c]
+                << " stencil mv test, relative error is " << err << '\n';
+    }
+    std::cerr << '\n';
+
+    std::cout << "\trelaxing memory...\n";
+    stencil::destroy(s7);
+    stencil::destroy(s27);
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(csr[0]);
+    csr::destroy(csr[1]);
+  }
+
+  {
+    std::cout << "\noverflow case\n";
+    // indptr of n=INT32_MAX rows cannot be indexed with 32-bit integers
+    const bool rejected =
+        !csr::create(std::numeric_limits<std::int32_t>::max(), 1) &&
+        !vec::create(std::numeric_limits<std::int64_t>::max());
+    std::cerr << '\t' << (rejected ? PASS : FAIL)
+              << " overflowing sizes are rejected\n";
+
+    // a row past the allocated non-zeros must not be written
+    csr::CSRMatrix *small = csr::create(2, 2);
+    const int cols[] = {0, 1, 0};
+    const double vals[] = {1.0, 2.0, 3.0};
+    const bool guarded = !csr::assign_row(*small, 0, cols, vals, 1) &&
+                         csr::assign_row(*small, 1, cols, vals, 2);
+    std::cerr << '\t' << (guarded ? PASS : FAIL)
+              << " rows past the allocated non-zeros are rejected\n\n";
+    csr::destroy(small);
+  }
+
+  {
+    // the same 5x5 matrix as a symmetric coordinate and a dense array file
+    std::cout << "\nMatrix Market case\n";
+    const std::string tmp = "test_data/mm_tmp.mtx";
+    mm::Header h;
+
+    std::cout << "\tloading test_sym.mtx and test_array.mtx...\n";
+    csr::CSRMatrix *full = mm::load_csr("test_data/test_sym.mtx", true, h);
+    csr::CSRMatrix *tri = mm::load_csr("test_data/test_sym.mtx", false, h);
+    coo::COOMatrix *coo = mm::load_coo("test_data/test_sym.mtx", true, h);
+    csr::CSRMatrix *dense = mm::load_csr("test_data/test_array.mtx", true, h);
+    if (!full || !tri || !coo || !dense) {
+      std::cerr << "cannot load Matrix Market files\n";
+      return 1;
+    }
+    const int n = full->n;
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    for (int i = 0; i < n; ++i) x->value[i] = std::cos(0.5 * i);
+    csr::mv(*dense, *x, *y_ref);
+
+    std::cout << "\tcomputing y=Ax with the expanded and stored forms...\n";
+    const char *names[] = {"expanded csr", "expanded coo", "csr::mv_sym"};
+    for (int c = 0; c < 3; ++c) {
+      const bool failed = c == 0   ? csr::mv(*full, *x, *buf)
+                          : c == 1 ? coo::mv(*coo, *x, *buf)
+                                   : csr::mv_sym(*tri, *x, *buf);
+      if (failed) {
+        std::cerr << "error occured in " << names[c] << " mv\n";
+        return 1;
+      }
+      const double err = nrm2_error(*buf, *y_ref);
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << ' ' << names[c]
+                << " mv test, relative error is " << err << "\n";
+    }
+
+    std::cout << "\twriting and reloading general and symmetric files...\n";
+    const mm::Symmetry syms[] = {mm::GENERAL, mm::SYMMETRIC};
+    for (int c = 0; c < 2; ++c) {
+      csr::CSRMatrix *re = nullptr;
+      if (!mm::write(tmp, *full, syms[c])) re = mm::load_csr(tmp, true, h);
+      if (!re) {
+        std::cerr << "cannot write and reload " << tmp << '\n';
+        return 1;
+      }
+      csr::mv(*re, *x, *buf);
+      const double err = nrm2_error(*buf, *y_ref);
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << " round trip "
+                << (c ? "symmetric" : "general")
+                << " test, relative error is " << err << "\n";
+      csr::destroy(re);
+    }
+    std::remove(tmp.c_str());
+    std::cerr << '\n';
+
+    std::cout << "\trelaxing memory...\n";
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(full);
+    csr::destroy(tri);
+    csr::destroy(dense);
+    coo::destroy(coo);
+  }
+
+  {
+    // every layout a generated matrix can be written in, reloaded from many
+    // small chunks so that the cuts, the array positions of later chunks and
+    // the scattered csr fill are all exercised
+    const int n = 300;
+    const std::string tmp = "test_data/mm_tmp.mtx";
+    std::cout << "\nMatrix Market layout case\n";
+
+    // integer values, so that integer files are exact
+    std::mt19937 gen(32);
+    csr::CSRMatrix *A = generate(n, 8, n, gen);
+    for (int k = 0; k < A->indptr[n]; ++k) {
+      A->value[k] = std::round(100.0 * A->value[k]);
+    }
+    csr::CSRMatrix *ones = copy(*A, n, true);
+    csr::CSRMatrix *lower = copy(*A, 0, false);
+    csr::CSRMatrix *strict = copy(*A, -1, false);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    for (int i = 0; i < n; ++i) x->value[i] = std::sin(0.3 * i);
+
+    struct Layout {
+      mm::Format format;
+      mm::Field field;
+      mm::Symmetry symmetry;
+      const char *name;
+    };
+    const Layout layouts[] = {
+        {mm::COORDINATE, mm::REAL, mm::GENERAL, "coordinate real general"},
+        {mm::COORDINATE, mm::INTEGER, mm::SYMMETRIC,
+         "coordinate integer symmetric"},
+        {mm::COORDINATE, mm::REAL, mm::SKEW_SYMMETRIC,
+         "coordinate real skew-symmetric"},
+        {mm::COORDINATE, mm::PATTERN, mm::GENERAL,
+         "coordinate pattern general"},
+        {mm::ARRAY, mm::INTEGER, mm::GENERAL, "array integer general"},
+        {mm::ARRAY, mm::REAL, mm::SYMMETRIC, "array real symmetric"},
+        {mm::ARRAY, mm::INTEGER, mm::SKEW_SYMMETRIC,
+         "array integer skew-symmetric"},
+    };
+    for (unsigned c = 0; c < sizeof(layouts) / sizeof(layouts[0]); ++c) {
+      const Layout &l = layouts[c];
+      const double sign = l.symmetry == mm::SKEW_SYMMETRIC ? -1.0 : 1.0;
+      if (l.symmetry == mm::GENERAL) {
+        csr::mv(l.field == mm::PATTERN ? *ones : *A, *x, *y_ref);
+      } else {
+        csr::mv_sym(l.symmetry == mm::SYMMETRIC ? *lower : *strict, *x,
+                    *y_ref, sign);
+      }
+
+      mm::Header h;
+      if (mm::write(tmp, *A, l.symmetry, l.field, l.format)) {
+        std::cerr << "cannot write " << l.name << " file\n";
+        return 1;
+      }
+      csr::CSRMatrix *full = mm::load_csr(tmp, true, h, 64);
+      coo::COOMatrix *coo = mm::load_coo(tmp, true, h, 64);
+      csr::CSRMatrix *tri = mm::load_csr(tmp, false, h, 64);
+      if (!full || !coo || !tri) {
+        std::cerr << "cannot reload " << l.name << " file\n";
+        return 1;
+      }
+
+      // expanded csr, expanded coo, and the stored triangle
+      double err = 0.0;
+      csr::mv(*full, *x, *buf);
+      err = std::max(err, nrm2_error(*buf, *y_ref));
+      coo::mv(*coo, *x, *buf);
+      err = std::max(err, nrm2_error(*buf, *y_ref));
+      if (l.symmetry == mm::GENERAL) {
+        csr::mv(*tri, *x, *buf);
+      } else {
+        csr::mv_sym(*tri, *x, *buf, sign);
+      }
+      err = std::max(err, nrm2_error(*buf, *y_ref));
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << ' ' << l.name
+                << " test, relative error is " << err << '\n';
+
+      csr::destroy(full);
+      coo::destroy(coo);
+      csr::destroy(tri);
+    }
+    const bool rejected = mm::write(tmp, *A, mm::GENERAL, mm::PATTERN,
+                                    mm::ARRAY);
+    std::cerr << '\t' << (rejected ? PASS : FAIL)
+              << " array pattern files are rejected\n\n";
+    std::remove(tmp.c_str());
+
+    std::cout << "\trelaxing memory...\n";
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(A);
+    csr::destroy(ones);
+    csr::destroy(lower);
+    csr::destroy(strict);
+  }
+
+  std::mt19937 rng(562);
+  {
+    // power-law rows: mostly 3 entries, a few with thousands, one dense
+    const int n = 20000;
+    std::cout << "\npower-law case\n";
+    csr::CSRMatrix *A = csr::create(n, 4 * n + (n / 200) * 5000);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    std::uniform_real_distribution<double> val(-1.0, 1.0);
+    std::vector<int> cols;
+    std::vector<double> vals;
+    for (int i = 0; i < n; ++i) {
+      int len = i % 7 == 0 ? 0 : 3;
+      if (i % 200 == 0) len = 5000;
+      if (i == n / 2) len = n;
+      cols.resize(len);
+      vals.resize(len);
+      for (int k = 0; k < len; ++k) {
+        cols[k] = len == n ? k : int((long(i) * 7919 + long(k) * 104729) % n);
+        vals[k] = val(rng);
+      }
+      csr::assign_row(*A, i, cols.data(), vals.data(), len);
+      x->value[i] = val(rng);
+    }
+    csr::mv(*A, *x, *y_ref);
+
+    std::cout << "\tcomputing y=Ax...\n";
+    if (csr::mv_merge(*A, *x, *buf)) {
+      std::cerr << "error occured in power-law mv_merge\n";
+      return 1;
+    }
+    double err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " power-law mv_merge test, relative error is " << err << '\n';
+    csr::RowBins *bins = csr::bin_rows(*A);
+    if (!bins || csr::mv_adaptive(*A, *bins, *x, *buf)) {
+      std::cerr << "error occured in power-law mv_adaptive\n";
+      return 1;
+    }
+    csr::destroy(bins);
+    err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " power-law mv_adaptive test, relative error is " << err
+              << "\n\n";
+
+    std::cout << "\trelaxing memory...\n";
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(A);
+  }
+
+  {
+    // large enough to be timed, with a private database
+    const int n = 4000;
+    const char *db = "test_data/tune_tmp.db";
+    std::cout << "\ntuning database case\n";
+    std::remove(db);
+
+    csr::CSRMatrix *A = generate(n, 8, 16, rng);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    for (int i = 0; i < n; ++i) x->value[i] = std::sin(0.1 * i);
+    csr::mv(*A, *x, *y_ref);
+
+    std::cout << "\ttiming the kernels...\n";
+    tune::Plan *first = tune::create(*A, db);
+    std::cout << "\tlooking the matrix up again...\n";
+    tune::Plan *second = tune::create(*A, db);
+    if (!first || !second) {
+      std::cerr << "cannot tune the database case\n";
+      return 1;
+    }
+    std::cout << "\tselected kernel " << tune::kernel_name(*first) << " with "
+              << tune::threads(*first) << " thread(s)\n";
+
+    // a hit returns the stored decision and appends nothing
+    std::ifstream f(db);
+    std::string line;
+    int lines = 0;
+    while (std::getline(f, line)) ++lines;
+    f.close();
+    const bool hit = lines == 1 &&
+                     std::string(tune::kernel_name(*first)) ==
+                         tune::kernel_name(*second) &&
+                     tune::threads(*first) == tune::threads(*second);
+    std::cerr << '\t' << (hit ? PASS : FAIL)
+              << " tuning database hit test, stored entries " << lines << '\n';
+
+    tune::mv(*second, *x, *buf);
+    const double err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " timed tuned mv test, relative error is " << err << "\n\n";
+    std::remove(db);
+
+    std::cout << "\trelaxing memory...\n";
+    tune::destroy(first);
+    tune::destroy(second);
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(A);
+  }
+
+  {
+    // a tridiagonal matrix whose values change after tuning, and a matrix
+    // of full 2x2 diagonal blocks
+    const int n = 100;
+    std::cout << "\ntuning update case\n";
+
+    csr::CSRMatrix *A = csr::create(n, 3 * n);
+    csr::CSRMatrix *B = csr::create(n, 2 * n);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *y_ref = vec::create(n);
+    vec::DenseVec *buf = vec::create(n);
+    for (int i = 0; i < n; ++i) {
+      const int first = i > 0 ? 0 : 1, last = i < n - 1 ? 3 : 2;
+      const int cols[] = {i - 1, i, i + 1}, pair[] = {i & ~1, i | 1};
+      const double vals[] = {-1.0, 2.0, -1.0}, ones[] = {1.0, 1.0};
+      csr::assign_row(*A, i, cols + first, vals + first, last - first);
+      csr::assign_row(*B, i, pair, ones, 2);
+      x->value[i] = std::sin(0.1 * i);
+    }
+
+    tune::Stats st;
+    const bool found = !tune::analyze(*B, st) && st.symmetric &&
+                       st.bandwidth == 1 && st.block_size == 2 &&
+                       st.block_fill == 1.0;
+    std::cerr << '\t' << (found ? PASS : FAIL)
+              << " block analysis test, block size " << st.block_size
+              << ", fill " << st.block_fill << '\n';
+
+    tune::Plan *plan = tune::create(*A, nullptr);
+    if (!plan) {
+      std::cerr << "cannot tune the update case\n";
+      return 1;
+    }
+    std::cout << "\tselected kernel " << tune::kernel_name(*plan) << '\n';
+
+    std::cout << "\tchanging the values in place...\n";
+    for (int k = 0; k < A->indptr[n]; ++k) A->value[k] = 2.0;
+    csr::mv(*A, *x, *y_ref);
+    if (tune::update(*plan) || tune::mv(*plan, *x, *buf)) {
+      std::cerr << "error occured in tuned mv\n";
+      return 1;
+    }
+    const double err = nrm2_error(*buf, *y_ref);
+    std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS)
+              << " updated tuned mv test, relative error is " << err
+              << "\n\n";
+
+    std::cout << "\trelaxing memory...\n";
+    tune::destroy(plan);
+    vec::destroy(x);
+    vec::destroy(y_ref);
+    vec::destroy(buf);
+    csr::destroy(A);
+    csr::destroy(B);
+  }
+
+  for (int c = 0; c < 2; ++c) {
+    // a shallow random DAG and a deep narrow-band one
+    const int n = 2000;
+    csr::CSRMatrix *A =
+        c == 0 ? generate(n, 8, n, rng) : generate(n, 8, 1, rng);
+    std::cout << "\ntriangular case " << c + 1 << '\n';
+
+    vec::DenseVec *b = vec::create(n);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *x_ref = vec::create(n);
+    vec::DenseVec *old = vec::create(n);
+    std::uniform_real_distribution<double> val(-1.0, 1.0);
+    for (int i = 0; i < n; ++i) b->value[i] = val(rng);
+
+    tri::Schedule *s = tri::analyze(*A);
+    if (!s) {
+      std::cerr << "cannot analyze triangular case " << c + 1 << '\n';
+      return 1;
+    }
+    std::cout << "\t" << s->nlower << " lower and " << s->nupper
+              << " upper levels\n";
+
+    const bool sync_free = s->sync_free;
+    for (int mode = 0; mode < 2; ++mode) {
+      s->sync_free = mode == 1;
+      const char *name = s->sync_free ? "sync-free" : "level-set";
+
+      std::cout << "\tsolving (D+L)x=b...\n";
+      sweep_ref(*A, true, b->value, x_ref->value, nullptr);
+      if (tri::lsolve(*A, *s, *b, *x)) {
+        std::cerr << "error occured in lsolve\n";
+        return 1;
+      }
+      double err = nrm2_error(*x, *x_ref);
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << ' ' << name
+                << " lsolve test for case " << c + 1
+                << ", relative error is " << err << '\n';
+
+      std::cout << "\tsolving (D+U)x=b...\n";
+      sweep_ref(*A, false, b->value, x_ref->value, nullptr);
+      if (tri::usolve(*A, *s, *b, *x)) {
+        std::cerr << "error occured in usolve\n";
+        return 1;
+      }
+      err = nrm2_error(*x, *x_ref);
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << ' ' << name
+                << " usolve test for case " << c + 1
+                << ", relative error is " << err << '\n';
+
+      std::cout << "\tsymmetric Gauss-Seidel sweeps...\n";
+      for (int i = 0; i < n; ++i) x->value[i] = x_ref->value[i] = 0.0;
+      for (int it = 0; it < 3; ++it) {
+        std::copy(x_ref->value, x_ref->value + n, old->value);
+        sweep_ref(*A, true, b->value, x_ref->value, old->value);
+        std::copy(x_ref->value, x_ref->value + n, old->value);
+        sweep_ref(*A, false, b->value, x_ref->value, old->value);
+        if (tri::sgs(*A, *s, *b, *x)) {
+          std::cerr << "error occured in sgs\n";
+          return 1;
+        }
+      }
+      err = nrm2_error(*x, *x_ref);
+      std::cerr << '\t' << (err > 1e-12 ? FAIL : PASS) << ' ' << name
+                << " sgs test for case " << c + 1
+                << ", relative error is " << err << '\n';
+    }
+    s->sync_free = sync_free;
+
+    std::cout << "\trelaxing memory...\n";
+    tri::destroy(s);
+    vec::destroy(b);
+    vec::destroy(x);
+    vec::destroy(x_ref);
+    vec::destroy(old);
+    csr::destroy(A);
+  }
+
+  {
+    // client threads interleave small and large products on one pool
+    const int nmat = 3, nclients = 8, nreq = 25;
+    const int sizes[nmat] = {50, 2000, 40000};
+    std::cout << "\npool case\n";
+
+    csr::CSRMatrix *mats[nmat];
+    vec::DenseVec *xs[nmat], *refs[nmat];
+    std::uniform_real_distribution<double> val(-1.0, 1.0);
+    for (int m = 0; m < nmat; ++m) {
+      mats[m] = generate(sizes[m], 8, sizes[m], rng);
+      xs[m] = vec::create(sizes[m]);
+      refs[m] = vec::create(sizes[m]);
+      for (int i = 0; i < sizes[m]; ++i) xs[m]->value[i] = val(rng);
+      csr::mv(*mats[m], *xs[m], *refs[m]);
+    }
+
+    pool::Pool *p = pool::create(4);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> clients;
+    std::cout << "\trunning " << nclients * nreq << " concurrent products...\n";
+    for (int c = 0; c < nclients; ++c) {
+      clients.push_back(std::thread([&, c]() {
+        for (int r = 0; r < nreq; ++r) {
+          const int m = (c + r) % nmat;
+          vec::DenseVec *y = vec::create(sizes[m]);
+          if (pool::wait(pool::submit_mv(*p, *mats[m], *xs[m], *y)) ||
+              nrm2_error(*y, *refs[m]) > 1e-12) {
+            ++failures;
+          }
+          vec::destroy(y);
+        }
+      }));
+    }
+    for (int c = 0; c < nclients; ++c) clients[c].join();
+    pool::destroy(p);
+
+    std::cout << "\tcomputing y=Ax on the shared pool...\n";
+    vec::DenseVec *y = vec::create(sizes[nmat - 1]);
+    if (pool::mv(*mats[nmat - 1], *xs[nmat - 1], *y) ||
+        nrm2_error(*y, *refs[nmat - 1]) > 1e-12) {
+      ++failures;
+    }
+    vec::destroy(y);
+
+    std::cerr << '\t' << (failures ? FAIL : PASS)
+              << " pool mv test, failed products " << failures << "\n\n";
+
+    std::cout << "\trelaxing memory...\n";
+    for (int m = 0; m < nmat; ++m) {
+      vec::destroy(xs[m]);
+      vec::destroy(refs[m]);
+      csr::destroy(mats[m]);
+    }
+  }
+
+  for (int c = 0; c < 2; ++c) {
+    // a well-conditioned matrix, then the same one scaled below the float
+    // range so that the float inner solver breaks down
+    const int n = 2000;
+    const double scale = c == 0 ? 1.0 : 1e-50;
+    std::cout << "\nmixed-precision case " << c + 1 << '\n';
+
+    csr::CSRMatrix *A = generate(n, 8, n, rng);
+    for (int k = 0; k < A->indptr[n]; ++k) A->value[k] *= scale;
+    vec::DenseVec *b = vec::create(n);
+    vec::DenseVec *x = vec::create(n);
+    vec::DenseVec *x_true = vec::create(n);
+    std::uniform_real_distribution<double> val(-1.0, 1.0);
+    for (int i = 0; i < n; ++i) {
+      x_true->value[i] = val(rng);
+      x->value[i] = 0.0;
+    }
+    csr::mv(*A, *x_true, *b);
+
+    std::cout << "\tsolving Ax=b by iterative refinement...\n";
+    mpir::Solver *s = mpir::create(*A);
+    mpir::Info info;
+    if (!s || mpir::solve(*s, *b, *x, 1e-15, info)) {
+      std::cerr << "error occured in mpir solve\n";
+      return 1;
+    }
+    std::cout << "\t" << info.outer << " refinement steps, " << info.inner
+              << " inner iterations" << (info.fallback ? ", fell back" : "")
+              << '\n';
+
+    const double err = nrm2_error(*x, *x_true);
+    const bool ok = err <= 1e-12 && info.fallback == (c == 1);
+    std::cerr << '\t' << (ok ? PASS : FAIL) << " mixed-precision solve test "
+              << c + 1 << ", relative error is " << err << "\n\n";
+
+    std::cout << "\trelaxing memory...\n";
+    mpir::destroy(s);
+    vec::destroy(b);
+    vec::destroy(x);
+    vec::destroy(x_true);
+    csr::destroy(A);
+  }
   return 0;
 }
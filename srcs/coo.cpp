@@ -2,20 +2,30 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstddef>
+#include <limits>
 #include "coo.hpp"
 #include "vec.hpp"
 
 namespace coo {
 
 // create a csr matrix
-COOMatrix *create(const int n, const int nnz) {
-  COOMatrix *ptr = nullptr;
+template <typename I>
+COOMatrixT<I> *create(const I n, const I nnz) {
+  COOMatrixT<I> *ptr = nullptr;
   if (n <= 0 || nnz <= 0) {
     std::cout << "Invalid matrix shape" << "\n";
     return ptr;
   }
 
-  ptr = new COOMatrix;
+  // the byte counts of the arrays must fit in size_t
+  if (static_cast<unsigned long long>(nnz) >
+      std::numeric_limits<std::size_t>::max() / sizeof(double)) {
+    std::cout << "Matrix size overflow" << "\n";
+    return ptr;
+  }
+
+  ptr = new COOMatrixT<I>;
 
   if (!ptr) {
     std::cout << "Allocation failed" << "\n";
@@ -33,15 +43,16 @@ COOMatrix *create(const int n, const int nnz) {
   ptr->nnz = nnz;
   
   // allocating arrays
-  ptr->i = new int[nnz];
-  ptr->j = new int[nnz];
+  ptr->i = new I[nnz];
+  ptr->j = new I[nnz];
   ptr->v = new double[nnz];
 
   return ptr;
 }
 
 // destroy a csr matrix
-void destroy(COOMatrix *mat) {
+template <typename I>
+void destroy(COOMatrixT<I> *mat) {
   if (!mat) {
     std::cout << "\tCOO matrix did not exisit\n";
     return;
@@ -62,8 +73,13 @@ void destroy(COOMatrix *mat) {
 }
 
 // assign a triplet (i,j,v)
-bool assign_ijv(COOMatrix &mat, const int i, const int j, const double v,
-                const int nnz_index) {
+template <typename I>
+bool assign_ijv(COOMatrixT<I> &mat, const typename COOMatrixT<I>::index_type i,
+                const typename COOMatrixT<I>::index_type j, const double v,
+                const typename COOMatrixT<I>::index_type nnz_index) {
+  // the triplet must lie inside the matrix and the arrays
+  if (nnz_index < 0 || nnz_index >= mat.nnz) return true;
+  if (i < 0 || i >= mat.n || j < 0 || j >= mat.n) return true;
   bool fail = false;
 
   mat.i[nnz_index] = i;
@@ -74,26 +90,27 @@ bool assign_ijv(COOMatrix &mat, const int i, const int j, const double v,
 }
 
 // extract the diagonal values
-bool extract_diag(const COOMatrix &A, vec::DenseVec &diag) {
+template <typename I>
+bool extract_diag(const COOMatrixT<I> &A, vec::DenseVecT<I> &diag) {
   if (A.n != diag.n) return true;
   bool fail = false;
 
   // setting n and nnz:
-  const int n = A.n;
-  const int nnz = A.nnz; // setting matrix.nnz to nnz
+  const I n = A.n;
+  const I nnz = A.nnz; // setting matrix.nnz to nnz
 
   // setting diag size to n
   diag.n = A.n;
 
  
   //initializing y array
-  for (int i=0; i<n; i++){
+  for (I i=0; i<n; i++){
     diag.value[i] = 0;
   }
 
-  for (int i=0; i<nnz; ++i){
-    int row_i = A.i[i];
-    int col_i = A.j[i];
+  for (I i=0; i<nnz; ++i){
+    I row_i = A.i[i];
+    I col_i = A.j[i];
 
     if (col_i == row_i) {
       diag.value[row_i] = A.v[i];
@@ -104,28 +121,52 @@ bool extract_diag(const COOMatrix &A, vec::DenseVec &diag) {
 }
 
 // matrix vector multiplication
-bool mv(const COOMatrix &A, const vec::DenseVec &x, vec::DenseVec &y) {
+template <typename I>
+bool mv(const COOMatrixT<I> &A, const vec::DenseVecT<I> &x,
+        vec::DenseVecT<I> &y) {
+  // x and y must cover every row and column
+  if (x.n != A.n || y.n != A.n) return true;
   bool fail = false;
-  const int n = A.n; // setting matrix.n to n
-  const int nnz = A.nnz; // setting matrix.nnz to nnz
-  
-  // setting y size to n
-  y.n = n;
+  const I n = A.n; // setting matrix.n to n
+  const I nnz = A.nnz; // setting matrix.nnz to nnz
   
   //initializing y array
-  for (int i=0; i<n; i++){
+  for (I i=0; i<n; i++){
     y.value[i] = 0;
   }
   
-  // std::cout << "n: " << n << std::endl;
-  for (int i=0; i<nnz; ++i){
+  for (I i=0; i<nnz; ++i){
 
-    int row_i = A.i[i];
-    int col_i = A.j[i];
+    I row_i = A.i[i];
+    I col_i = A.j[i];
 
     y.value[row_i] = y.value[row_i] + A.v[i]*x.value[col_i];
   }
     return fail;
 }
 
+// instantiations
+template COOMatrixT<std::int32_t> *create(const std::int32_t n,
+                                          const std::int32_t nnz);
+template COOMatrixT<std::int64_t> *create(const std::int64_t n,
+                                          const std::int64_t nnz);
+template void destroy(COOMatrixT<std::int32_t> *mat);
+template void destroy(COOMatrixT<std::int64_t> *mat);
+template bool assign_ijv(COOMatrixT<std::int32_t> &mat, const std::int32_t i,
+                         const std::int32_t j, const double v,
+                         const std::int32_t nnz_index);
+template bool assign_ijv(COOMatrixT<std::int64_t> &mat, const std::int64_t i,
+                         const std::int64_t j, const double v,
+                         const std::int64_t nnz_index);
+template bool extract_diag(const COOMatrixT<std::int32_t> &A,
+                           vec::DenseVecT<std::int32_t> &diag);
+template bool extract_diag(const COOMatrixT<std::int64_t> &A,
+                           vec::DenseVecT<std::int64_t> &diag);
+template bool mv(const COOMatrixT<std::int32_t> &A,
+                 const vec::DenseVecT<std::int32_t> &x,
+                 vec::DenseVecT<std::int32_t> &y);
+template bool mv(const COOMatrixT<std::int64_t> &A,
+                 const vec::DenseVecT<std::int64_t> &x,
+                 vec::DenseVecT<std::int64_t> &y);
+
 } // namespace coo
@@ -5,33 +5,49 @@
 #ifndef _COO_HPP
 #define _COO_HPP
 
+#include <cstdint>
+
 // declaration
 namespace vec {
-struct DenseVec;
+template <typename I>
+struct DenseVecT;
+typedef DenseVecT<std::int32_t> DenseVec;
 }
 
 namespace coo {
 
-/// \struct COOMatrix
+/// \struct COOMatrixT
 /// \brief structure of csr representation
-struct COOMatrix {
-  double *v;  ///< value data array
-  int *i;     ///< row indices
-  int *j;     ///< column indices
-  int n;      ///< size of the square matrix
-  int nnz;    ///< total number of non-zeros
+/// \tparam I index type, std::int32_t or std::int64_t
+template <typename I>
+struct COOMatrixT {
+  typedef I index_type;  ///< type of sizes and indices
+  double *v;             ///< value data array
+  I *i;                  ///< row indices
+  I *j;                  ///< column indices
+  I n;                   ///< size of the square matrix
+  I nnz;                 ///< total number of non-zeros
 };
 
+/// \brief coo matrix with 32-bit indices
+typedef COOMatrixT<std::int32_t> COOMatrix;
+
+/// \brief coo matrix with 64-bit indices
+typedef COOMatrixT<std::int64_t> COOMatrix64;
+
 /// \brief create a csr matrix
 /// \param[in] n row/column size of the squared matrix
 /// \param[in] nnz total number of non-zeros
-/// \return COO matrix pointer that points to the database
+/// \return COO matrix pointer that points to the database, \a nullptr if the
+///         sizes are not positive or overflow
 /// \sa destroy
-COOMatrix *create(const int n, const int nnz);
+template <typename I>
+COOMatrixT<I> *create(const I n, const I nnz);
 
 /// \brief destroy a csr matrix
 /// \param[in] mat coo matrix that is allocated by create_csr
-void destroy(COOMatrix *mat);
+template <typename I>
+void destroy(COOMatrixT<I> *mat);
 
 /// \brief assign a triplet (i,j,v)
 /// \param[out] mat coo matrix
@@ -40,14 +56,17 @@ void destroy(COOMatrix *mat);
 /// \param[in] v value entry
 /// \param[in] nnz_index array index of (i,j,v)
 /// \return \a true if things go wrong, \a false ew
-bool assign_ijv(COOMatrix &mat, const int i, const int j, const double v,
-                const int nnz_index);
+template <typename I>
+bool assign_ijv(COOMatrixT<I> &mat, const typename COOMatrixT<I>::index_type i,
+                const typename COOMatrixT<I>::index_type j, const double v,
+                const typename COOMatrixT<I>::index_type nnz_index);
 
 /// \brief extract the diagonal values
 /// \param[in] A input coo matrix
 /// \param[out] d diagonal entries
 /// \return \a true if things go wrong, \a false ew
-bool extract_diag(const COOMatrix &A, vec::DenseVec &diag);
+template <typename I>
+bool extract_diag(const COOMatrixT<I> &A, vec::DenseVecT<I> &diag);
 
 /// \brief matrix vector multiplication
 /// \param[in] A input coo matrix
@@ -57,7 +76,9 @@ bool extract_diag(const COOMatrix &A, vec::DenseVec &diag);
 ///
 /// This function essentially is to compute y=A*x, where A is a squared matrix
 /// and x is the rhs vector
-bool mv(const COOMatrix &A, const vec::DenseVec &x, vec::DenseVec &y);
+template <typename I>
+bool mv(const COOMatrixT<I> &A, const vec::DenseVecT<I> &x,
+        vec::DenseVecT<I> &y);
 
 }  // namespace coo
 
@@ -5,21 +5,45 @@
 #include "vec.hpp"
 
 #include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace csr {
 
+// rows and non-zeros of one range of rows handed out by mv_adaptive
+static const int RANGE_ROWS = 1024;
+static const int RANGE_NNZ = 1 << 15;
+
+// rows longer than this are reduced by all threads
+static const int LONG_ROW = 1 << 12;
+
 // impls
 
 // create a csr matrix
-CSRMatrix *create(const int n, const int nnz) {
-  CSRMatrix *ptr = nullptr;
+template <typename I>
+CSRMatrixT<I> *create(const I n, const I nnz) {
+  CSRMatrixT<I> *ptr = nullptr;
   if (n <= 0 || nnz <= 0) {
     std::cout << "Invalid matrix shape" << "\n";
     return ptr;
   }
 
-  ptr = new CSRMatrix;
+  // indptr needs n+1 entries, and the byte counts must fit in size_t
+  if (n == std::numeric_limits<I>::max() ||
+      static_cast<unsigned long long>(nnz) >
+          std::numeric_limits<std::size_t>::max() / sizeof(double)) {
+    std::cout << "Matrix size overflow" << "\n";
+    return ptr;
+  }
+
+  ptr = new CSRMatrixT<I>;
 
   if (!ptr) {
     std::cout << "Allocation failed" << "\n";
@@ -31,25 +55,27 @@ CSRMatrix *create(const int n, const int nnz) {
   ptr->indptr = nullptr;
   ptr->value = nullptr;
   
-  // intializing ptr->n 
+  // intializing ptr->n and the capacity
   ptr->n = n;
+  ptr->nnz = nnz;
 
   // getting lengths of arrays
   // indicies and value array have nnz length
-  const int indptr_length = n + 1;
+  const I indptr_length = n + 1;
 
   // allocating value array
   ptr->value = new double[nnz];
   // allocating indices array
-  ptr->indices = new int[nnz];
+  ptr->indices = new I[nnz];
   // allocating indptr array
-  ptr->indptr = new int[indptr_length];
+  ptr->indptr = new I[indptr_length];
 
   return ptr;
 }
 
 // destroy a csr matrix
-void destroy(CSRMatrix *mat) {
+template <typename I>
+void destroy(CSRMatrixT<I> *mat) {
   if (!mat) {
     std::cout << "\tCSR matrix did not exisit\n";
     return;
@@ -71,17 +97,23 @@ void destroy(CSRMatrix *mat) {
 }
 
 // assign a row
-bool assign_row(CSRMatrix &mat, const int row, const int *cols,
-                const double *vals, const int nnz) {
-  if (row < 0 || row > mat.n || nnz < 0) return true;
+template <typename I>
+bool assign_row(CSRMatrixT<I> &mat,
+                const typename CSRMatrixT<I>::index_type row, const I *cols,
+                const double *vals,
+                const typename CSRMatrixT<I>::index_type nnz) {
+  if (row < 0 || row >= mat.n || nnz < 0) return true;
   
   mat.indptr[0] = 0;
-  int indptr_index = row + 1;
+  // the row must fit in the allocated entries, which also keeps the row
+  // pointer representable
+  if (nnz > mat.nnz - mat.indptr[row]) return true;
+  I indptr_index = row + 1;
   mat.indptr[indptr_index] = mat.indptr[row] + nnz;   
   
   // assigning mat.indices and mat.value array
-  for (unsigned i=0; i<nnz; ++i) {
-    const int start = mat.indptr[row]; // bonus, this is how to get the starting entry of this row
+  for (I i=0; i<nnz; ++i) {
+    const I start = mat.indptr[row]; // bonus, this is how to get the starting entry of this row
 
     mat.indices[start + i] = cols[i];
     mat.value[start + i] = vals[i];
@@ -93,26 +125,27 @@ bool assign_row(CSRMatrix &mat, const int row, const int *cols,
 }
 
 // extract the diagonal values
-bool extract_diag(const CSRMatrix &A, vec::DenseVec &diag) {
+template <typename I>
+bool extract_diag(const CSRMatrixT<I> &A, vec::DenseVecT<I> &diag) {
   if (A.n != diag.n) return true;
   bool fail = false;
 
   // setting n and nnz:
-  const int n = A.n;
+  const I n = A.n;
 
   // setting diag size to n
   diag.n = A.n;
 
   //initializing diag array
-  for (int i=0; i<n; i++){
+  for (I i=0; i<n; i++){
     diag.value[i] = 0;
   }
 
-  for (int i=0; i<n; ++i) {
-    int start = A.indptr[i];
-    int nnz = A.indptr[i+1] - A.indptr[i];
-    for (int j=0; j<nnz; ++j) {
-      int Aj = A.indices[start+j];
+  for (I i=0; i<n; ++i) {
+    I start = A.indptr[i];
+    I nnz = A.indptr[i+1] - A.indptr[i];
+    for (I j=0; j<nnz; ++j) {
+      I Aj = A.indices[start+j];
       double Aij = A.value[start+j];
       if (i == Aj) {
         diag.value[i] = Aij;
@@ -124,35 +157,247 @@ bool extract_diag(const CSRMatrix &A, vec::DenseVec &diag) {
 }
 
 // matrix vector multiplication
-bool mv(const CSRMatrix &A, const vec::DenseVec &x, vec::DenseVec &y) {
+template <typename I>
+bool mv(const CSRMatrixT<I> &A, const vec::DenseVecT<I> &x,
+        vec::DenseVecT<I> &y) {
+  // x and y must cover every row and column
+  if (x.n != A.n || y.n != A.n) return true;
   bool fail = false;
 
-  const int n = A.n; // setting matrix.n to n
-  
-  // setting y size to n
-  y.n = n;
+  const I n = A.n; // setting matrix.n to n
   
   //initializing y array
-  for (unsigned i=0; i<n; i++){
+  for (I i=0; i<n; i++){
     y.value[i] = 0;
   }
 
   // solving for y
-  for (int i=0; i<n; ++i){
-    int start = A.indptr[i];
-    int nnz = A.indptr[i+1] - A.indptr[i];
-    // std::cout << "start: " << start << std::endl;
-    // std::cout << "nnz: " << nnz << std::endl;
-    // std::cout << "Using following to calculate y[i]: " << i << std::endl;
-    for (int j=0; j<nnz; ++j) {
-      // std::cout << "A[ij]: " << A.value[start+j] << std::endl;
+  for (I i=0; i<n; ++i){
+    I start = A.indptr[i];
+    I nnz = A.indptr[i+1] - A.indptr[i];
+    for (I j=0; j<nnz; ++j) {
       double Aij = A.value[start+j];
-      // std::cout << "A.column[ij]: " << A.indices[start+j] << std::endl;
-      int Aj = A.indices[start+j];
+      I Aj = A.indices[start+j];
       y.value[i] = y.value[i] + Aij * x.value[Aj];
     }
   }
   return fail;
 }
 
+// matrix vector multiplication with one stored triangle
+template <typename I>
+bool mv_sym(const CSRMatrixT<I> &A, const vec::DenseVecT<I> &x,
+            vec::DenseVecT<I> &y, const double sign) {
+  if (x.n != A.n || y.n != A.n) return true;
+
+  const I n = A.n;
+  for (I i = 0; i < n; ++i) {
+    y.value[i] = 0;
+  }
+
+  // row i gathers the stored entries and scatters their mirrors
+  for (I i = 0; i < n; ++i) {
+    double sum = 0.0;
+    const double xi = x.value[i];
+    for (I k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      const I j = A.indices[k];
+      sum += A.value[k] * x.value[j];
+      if (j != i) y.value[j] += sign * A.value[k] * xi;
+    }
+    y.value[i] += sum;
+  }
+  return false;
+}
+
+// instantiations
+template CSRMatrixT<std::int32_t> *create(const std::int32_t n,
+                                          const std::int32_t nnz);
+template CSRMatrixT<std::int64_t> *create(const std::int64_t n,
+                                          const std::int64_t nnz);
+template void destroy(CSRMatrixT<std::int32_t> *mat);
+template void destroy(CSRMatrixT<std::int64_t> *mat);
+template bool assign_row(CSRMatrixT<std::int32_t> &mat, const std::int32_t row,
+                         const std::int32_t *cols, const double *vals,
+                         const std::int32_t nnz);
+template bool assign_row(CSRMatrixT<std::int64_t> &mat, const std::int64_t row,
+                         const std::int64_t *cols, const double *vals,
+                         const std::int64_t nnz);
+template bool extract_diag(const CSRMatrixT<std::int32_t> &A,
+                           vec::DenseVecT<std::int32_t> &diag);
+template bool extract_diag(const CSRMatrixT<std::int64_t> &A,
+                           vec::DenseVecT<std::int64_t> &diag);
+template bool mv(const CSRMatrixT<std::int32_t> &A,
+                 const vec::DenseVecT<std::int32_t> &x,
+                 vec::DenseVecT<std::int32_t> &y);
+template bool mv(const CSRMatrixT<std::int64_t> &A,
+                 const vec::DenseVecT<std::int64_t> &x,
+                 vec::DenseVecT<std::int64_t> &y);
+template bool mv_sym(const CSRMatrixT<std::int32_t> &A,
+                     const vec::DenseVecT<std::int32_t> &x,
+                     vec::DenseVecT<std::int32_t> &y, const double sign);
+template bool mv_sym(const CSRMatrixT<std::int64_t> &A,
+                     const vec::DenseVecT<std::int64_t> &x,
+                     vec::DenseVecT<std::int64_t> &y, const double sign);
+
+// merge-path matrix vector multiplication
+bool mv_merge(const CSRMatrix &A, const vec::DenseVec &x, vec::DenseVec &y) {
+  if (x.n != A.n || y.n != A.n) return true;
+
+  const int n = A.n;
+  const int nnz = A.indptr[n];
+  const int *row_end = A.indptr + 1;
+
+  int nparts = 1;
+#ifdef _OPENMP
+  nparts = omp_get_max_threads();
+#endif
+  // each part covers the same number of merge items (row ends + non-zeros)
+  const long total = long(n) + nnz;
+  const long per_part = (total + nparts - 1) / nparts;
+
+  // row and value left unfinished by each part
+  std::vector<int> carry_row(nparts, n);
+  std::vector<double> carry_val(nparts, 0.0);
+
+#pragma omp parallel for schedule(static, 1)
+  for (int t = 0; t < nparts; ++t) {
+    // find the merge coordinates (row, nz) of both ends of this part
+    int i = 0, k = 0, i_end = 0, k_end = 0;
+    for (int side = 0; side < 2; ++side) {
+      const long d = std::min(total, per_part * (t + side));
+      int lo = int(std::max(0L, d - nnz)), hi = int(std::min(d, long(n)));
+      while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (row_end[mid] <= d - mid - 1) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (side == 0) {
+        i = lo;
+        k = int(d - lo);
+      } else {
+        i_end = lo;
+        k_end = int(d - lo);
+      }
+    }
+
+    // rows finished inside this part, the first one may be partial
+    for (; i < i_end; ++i) {
+      double sum = 0.0;
+      for (; k < row_end[i]; ++k) {
+        sum += A.value[k] * x.value[A.indices[k]];
+      }
+      y.value[i] = sum;
+    }
+
+    // leading part of the row that the next part finishes
+    double sum = 0.0;
+    for (; k < k_end; ++k) {
+      sum += A.value[k] * x.value[A.indices[k]];
+    }
+    carry_row[t] = i_end;
+    carry_val[t] = sum;
+  }
+
+  // fix up the rows that span parts
+  for (int t = 0; t < nparts; ++t) {
+    if (carry_row[t] < n) y.value[carry_row[t]] += carry_val[t];
+  }
+  return false;
+}
+
+// group the rows of a matrix by length
+RowBins *bin_rows(const CSRMatrix &A) {
+  const int n = A.n;
+  if (n <= 0) {
+    std::cout << "Invalid matrix shape" << "\n";
+    return nullptr;
+  }
+
+  std::vector<int> ranges, long_rows;
+  int begin = 0;
+  for (int i = 0; i < n; ++i) {
+    const int len = A.indptr[i + 1] - A.indptr[i];
+    if (len > LONG_ROW) {
+      if (begin < i) ranges.push_back(begin), ranges.push_back(i);
+      long_rows.push_back(i);
+      begin = i + 1;
+    } else if (i + 1 - begin >= RANGE_ROWS ||
+               A.indptr[i + 1] - A.indptr[begin] >= RANGE_NNZ) {
+      ranges.push_back(begin), ranges.push_back(i + 1);
+      begin = i + 1;
+    }
+  }
+  if (begin < n) ranges.push_back(begin), ranges.push_back(n);
+
+  RowBins *bins = new RowBins;
+  bins->n = n;
+  bins->nranges = ranges.size() / 2;
+  bins->nlong = long_rows.size();
+  bins->ranges = new int[ranges.size()];
+  bins->long_rows = new int[long_rows.size()];
+  std::copy(ranges.begin(), ranges.end(), bins->ranges);
+  std::copy(long_rows.begin(), long_rows.end(), bins->long_rows);
+  return bins;
+}
+
+// destroy row bins
+void destroy(RowBins *bins) {
+  if (!bins) return;
+  delete[] bins->ranges;
+  delete[] bins->long_rows;
+  delete bins;
+}
+
+// row-length adaptive matrix vector multiplication
+bool mv_adaptive(const CSRMatrix &A, const RowBins &bins,
+                 const vec::DenseVec &x, vec::DenseVec &y) {
+  if (bins.n != A.n || x.n != A.n || y.n != A.n) return true;
+
+  const int *ptr = A.indptr, *ind = A.indices;
+  const double *val = A.value, *xv = x.value;
+  double *yv = y.value;
+  const int nranges = bins.nranges;
+  const int *ranges = bins.ranges;
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int r = 0; r < nranges; ++r) {
+    for (int i = ranges[2 * r]; i < ranges[2 * r + 1]; ++i) {
+      double sum = 0.0;
+      for (int k = ptr[i]; k < ptr[i + 1]; ++k) sum += val[k] * xv[ind[k]];
+      yv[i] = sum;
+    }
+  }
+
+  if (!bins.nlong) return false;
+
+  // long rows share one parallel region, each row costs two barriers rather
+  // than a fork/join; sum must be shared for the orphaned reduction
+  double sum = 0.0;
+#pragma omp parallel
+  for (int r = 0; r < bins.nlong; ++r) {
+    const int i = bins.long_rows[r];
+#pragma omp for reduction(+ : sum) schedule(static)
+    for (int k = ptr[i]; k < ptr[i + 1]; ++k) sum += val[k] * xv[ind[k]];
+#pragma omp single
+    {
+      yv[i] = sum;
+      sum = 0.0;
+    }
+  }
+  return false;
+}
+
+// row-length adaptive multiplication with one-off bins
+bool mv_adaptive(const CSRMatrix &A, const vec::DenseVec &x,
+                 vec::DenseVec &y) {
+  if (x.n != A.n || y.n != A.n) return true;
+  RowBins *bins = bin_rows(A);
+  if (!bins) return true;
+  const bool fail = mv_adaptive(A, *bins, x, y);
+  destroy(bins);
+  return fail;
+}
+
 }  // namespace csr
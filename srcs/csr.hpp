@@ -5,32 +5,53 @@
 #ifndef _CSR_HPP
 #define _CSR_HPP
 
+#include <cstdint>
+
 // declaration
 namespace vec {
-struct DenseVec;
+template <typename I>
+struct DenseVecT;
+typedef DenseVecT<std::int32_t> DenseVec;
 }
 
 namespace csr {
 
-/// \struct CSRMatrix
+/// \struct CSRMatrixT
 /// \brief structure of csr representation
-struct CSRMatrix {
-  double *value;  ///< value data array
-  int *indices;   ///< column indices array
-  int *indptr;    ///< row pointer array
-  int n;          ///< size of the square matrix
+/// \tparam I index type, std::int32_t or std::int64_t
+///
+/// The index type bounds both the size and the number of non-zeros. Keep
+/// the 32-bit instantiation when it fits, its index arrays take half of
+/// the memory traffic of the 64-bit one.
+template <typename I>
+struct CSRMatrixT {
+  typedef I index_type;  ///< type of sizes and indices
+  double *value;         ///< value data array
+  I *indices;            ///< column indices array
+  I *indptr;             ///< row pointer array
+  I n;                   ///< size of the square matrix
+  I nnz;                 ///< allocated length of indices and value
 };
 
+/// \brief csr matrix with 32-bit indices
+typedef CSRMatrixT<std::int32_t> CSRMatrix;
+
+/// \brief csr matrix with 64-bit indices
+typedef CSRMatrixT<std::int64_t> CSRMatrix64;
+
 /// \brief create a csr matrix
 /// \param[in] n row/column size of the squared matrix
 /// \param[in] nnz non-zeros count
-/// \return CSR matrix pointer that points to the database
+/// \return CSR matrix pointer that points to the database, \a nullptr if the
+///         sizes are not positive or overflow
 /// \sa destroy_csr
-CSRMatrix *create(const int n, const int nnz);
+template <typename I>
+CSRMatrixT<I> *create(const I n, const I nnz);
 
 /// \brief destroy a csr matrix
 /// \param[in] mat csr matrix that is allocated by create_csr
-void destroy(CSRMatrix *mat);
+template <typename I>
+void destroy(CSRMatrixT<I> *mat);
 
 /// \brief assign a row
 /// \param[out] csr csr matrix
@@ -39,15 +60,22 @@ void destroy(CSRMatrix *mat);
 /// \param[in] vals corresponding values regarding \a cols
 /// \param[in] nnz number of nonzeros
 /// \return \a true if things go wrong, \a false ew
-bool assign_row(CSRMatrix &mat, const int row, const int *cols,
-                const double *vals, const int nnz);
+///
+/// Rows must be assigned in order; a row that would end past the allocated
+/// \a mat.nnz entries is rejected.
+template <typename I>
+bool assign_row(CSRMatrixT<I> &mat,
+                const typename CSRMatrixT<I>::index_type row, const I *cols,
+                const double *vals,
+                const typename CSRMatrixT<I>::index_type nnz);
 
 /// \brief extract the diagonal values
 /// \note A binary search implementation will gain you extra credits
 /// \param[in] A input csr matrix
 /// \param[out] d diagonal entries
 /// \return \a true if things go wrong, \a false ew
-bool extract_diag(const CSRMatrix &A, vec::DenseVec &diag);
+template <typename I>
+bool extract_diag(const CSRMatrixT<I> &A, vec::DenseVecT<I> &diag);
 
 /// \brief matrix vector multiplication
 /// \param[in] A input csr matrix
@@ -57,7 +85,79 @@ bool extract_diag(const CSRMatrix &A, vec::DenseVec &diag);
 ///
 /// This function essentially is to compute y=A*x, where A is a squared matrix
 /// and x is the rhs vector
-bool mv(const CSRMatrix &A, const vec::DenseVec &x, vec::DenseVec &y);
+template <typename I>
+bool mv(const CSRMatrixT<I> &A, const vec::DenseVecT<I> &x,
+        vec::DenseVecT<I> &y);
+
+/// \brief matrix vector multiplication with one stored triangle
+/// \param[in] A one triangle of a symmetric or skew-symmetric matrix
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \param[in] sign 1 for symmetric, -1 for skew-symmetric matrices
+/// \return  \a true if things go wrong, \a false ew
+///
+/// Computes y=(A+sign*A^T)x with the diagonal counted once. Every stored
+/// off-diagonal entry stands for itself and its mirror, as in the
+/// symmetric Matrix Market files kept unexpanded by mm::load_csr.
+template <typename I>
+bool mv_sym(const CSRMatrixT<I> &A, const vec::DenseVecT<I> &x,
+            vec::DenseVecT<I> &y, const double sign = 1.0);
+
+/// \brief merge-path matrix vector multiplication
+/// \param[in] A input csr matrix
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \return  \a true if things go wrong, \a false ew
+///
+/// The merged sequence of row ends and non-zeros is split evenly across
+/// the OpenMP threads, so a thread may start or stop in the middle of a row.
+/// The partial sums of such rows are carried out and added after the
+/// parallel loop. The balance does not depend on the row lengths.
+bool mv_merge(const CSRMatrix &A, const vec::DenseVec &x, vec::DenseVec &y);
+
+/// \struct RowBins
+/// \brief rows of a matrix grouped by length for mv_adaptive
+///
+/// Rows of up to 4096 non-zeros are cut into ranges of consecutive rows
+/// with a bounded number of rows and non-zeros, so many short rows or a few
+/// medium ones make up a range. Longer rows are kept aside. Grouping is a
+/// serial pass over the rows, so it is done once per matrix and reused by
+/// every product, like the level sets of tri::Schedule.
+struct RowBins {
+  int *ranges;     ///< begin and end row of each range, interleaved
+  int nranges;     ///< number of ranges
+  int *long_rows;  ///< rows longer than 4096 non-zeros
+  int nlong;       ///< number of long rows
+  int n;           ///< size of the square matrix
+};
+
+/// \brief group the rows of a matrix by length
+/// \param[in] A input csr matrix
+/// \return bins pointer, \a nullptr if things go wrong
+/// \sa destroy
+RowBins *bin_rows(const CSRMatrix &A);
+
+/// \brief destroy row bins
+/// \param[in] bins bins that are allocated by bin_rows
+void destroy(RowBins *bins);
+
+/// \brief row-length adaptive matrix vector multiplication
+/// \param[in] A input csr matrix
+/// \param[in] bins row bins of \a A
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \return  \a true if things go wrong, \a false ew
+///
+/// The ranges are handed out dynamically in row order, and every long row is
+/// reduced by all threads together.
+bool mv_adaptive(const CSRMatrix &A, const RowBins &bins,
+                 const vec::DenseVec &x, vec::DenseVec &y);
+
+/// \brief row-length adaptive matrix vector multiplication
+/// \note The rows are grouped on every call, keep a RowBins for repeated
+///       products with the same matrix.
+bool mv_adaptive(const CSRMatrix &A, const vec::DenseVec &x,
+                 vec::DenseVec &y);
 
 }  // namespace csr
 
@@ -0,0 +1,671 @@
+// This is the source file that contains the implementation of
+// the Matrix Market reader and writer
+
+#include "mmio.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace mm {
+
+// chunks per thread, so that uneven lines still balance
+static const int CHUNKS_PER_THREAD = 4;
+
+/// \struct Chunk
+/// \brief a range of whole lines of the data section
+struct Chunk {
+  const char *begin;  ///< first character of the first line
+  const char *end;    ///< one past the last line
+  long long first;    ///< global index of the first entry
+  long long lines;    ///< entries in this chunk
+  long long out;      ///< position of the first output entry
+};
+
+/// \struct Entry
+/// \brief one parsed entry, 0-based
+struct Entry {
+  long long i;  ///< row index
+  long long j;  ///< column index
+  double v;     ///< value
+};
+
+static std::string lower(std::string s) {
+  for (size_t k = 0; k < s.size(); ++k) {
+    s[k] = char(std::tolower(static_cast<unsigned char>(s[k])));
+  }
+  return s;
+}
+
+// true for blank and comment lines
+static bool skip_line(const char *p, const char *eol) {
+  while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+  return p == eol || *p == '%';
+}
+
+// parse the banner, comments and size line, data is set to the offset of
+// the first data line
+static bool parse_header(const std::string &buf, Header &h, size_t &data) {
+  size_t eol = buf.find('\n');
+  std::istringstream banner(buf.substr(0, eol));
+  std::string tag, object, format, field, symmetry;
+  banner >> tag >> object >> format >> field >> symmetry;
+  if (tag != "%%MatrixMarket" || lower(object) != "matrix") {
+    std::cerr << "missing Matrix Market banner\n";
+    return true;
+  }
+
+  format = lower(format);
+  field = lower(field);
+  symmetry = lower(symmetry);
+  if (format == "coordinate") {
+    h.format = COORDINATE;
+  } else if (format == "array") {
+    h.format = ARRAY;
+  } else {
+    std::cerr << "unsupported Matrix Market format " << format << '\n';
+    return true;
+  }
+  if (field == "real" || field == "double") {
+    h.field = REAL;
+  } else if (field == "integer") {
+    h.field = INTEGER;
+  } else if (field == "pattern" && h.format == COORDINATE) {
+    h.field = PATTERN;
+  } else {
+    std::cerr << "unsupported Matrix Market field " << field << '\n';
+    return true;
+  }
+  if (symmetry == "general") {
+    h.symmetry = GENERAL;
+  } else if (symmetry == "symmetric") {
+    h.symmetry = SYMMETRIC;
+  } else if (symmetry == "skew-symmetric") {
+    h.symmetry = SKEW_SYMMETRIC;
+  } else {
+    std::cerr << "unsupported Matrix Market symmetry " << symmetry << '\n';
+    return true;
+  }
+
+  // skip the comments up to the size line
+  size_t pos = eol == std::string::npos ? buf.size() : eol + 1;
+  while (pos < buf.size()) {
+    eol = buf.find('\n', pos);
+    if (eol == std::string::npos) eol = buf.size();
+    if (!skip_line(buf.data() + pos, buf.data() + eol)) break;
+    pos = eol + 1;
+  }
+  if (pos >= buf.size()) {
+    std::cerr << "missing Matrix Market size line\n";
+    return true;
+  }
+
+  std::istringstream size(buf.substr(pos, eol - pos));
+  if (!(size >> h.rows >> h.cols) ||
+      (h.format == COORDINATE && !(size >> h.entries))) {
+    std::cerr << "invalid Matrix Market size line\n";
+    return true;
+  }
+  if (h.rows <= 0 || h.rows != h.cols) {
+    std::cerr << "only square matrices are supported\n";
+    return true;
+  }
+  if (h.format == ARRAY) {
+    const long long n = h.rows;
+    if (h.symmetry == GENERAL) h.entries = n * n;
+    if (h.symmetry == SYMMETRIC) h.entries = n * (n + 1) / 2;
+    if (h.symmetry == SKEW_SYMMETRIC) h.entries = n * (n - 1) / 2;
+  }
+  if (h.entries <= 0) {
+    std::cerr << "Matrix Market file has no entries\n";
+    return true;
+  }
+
+  data = eol < buf.size() ? eol + 1 : buf.size();
+  return false;
+}
+
+// read the banner and size line only
+bool read_header(const std::string &filename, Header &h) {
+  std::ifstream f(filename.c_str());
+  if (!f.is_open()) {
+    std::cerr << "cannot open file " << filename << '\n';
+    return true;
+  }
+  // the banner, then the comments up to and including the size line
+  std::string buf, line;
+  if (std::getline(f, line)) buf = line + '\n';
+  while (std::getline(f, line)) {
+    buf += line + '\n';
+    if (!skip_line(line.data(), line.data() + line.size())) break;
+  }
+  size_t data;
+  return parse_header(buf, h, data);
+}
+
+// read the whole file and cut its data section into chunks of whole lines
+static bool slurp(const std::string &filename, const size_t min_chunk,
+                  std::string &buf, Header &h, std::vector<Chunk> &chunks) {
+  std::ifstream f(filename.c_str(), std::ios::binary);
+  if (!f.is_open()) {
+    std::cerr << "cannot open file " << filename << '\n';
+    return true;
+  }
+  f.seekg(0, std::ios::end);
+  buf.resize(size_t(f.tellg()));
+  f.seekg(0, std::ios::beg);
+  f.read(&buf[0], buf.size());
+  if (!f) {
+    std::cerr << "cannot read file " << filename << '\n';
+    return true;
+  }
+
+  size_t data;
+  if (parse_header(buf, h, data)) return true;
+
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  const size_t bytes = buf.size() - data;
+  const size_t nchunks = std::max(
+      size_t(1),
+      std::min(size_t(threads) * CHUNKS_PER_THREAD,
+               bytes / std::max(size_t(1), min_chunk)));
+
+  const char *base = buf.data();
+  const char *stop = base + buf.size();
+  const char *p = base + data;
+  for (size_t c = 0; c < nchunks && p < stop; ++c) {
+    const char *e = base + data + bytes * (c + 1) / nchunks;
+    if (e < p) e = p;
+    // move the cut to the start of the next line
+    if (e < stop) {
+      const void *nl = std::memchr(e, '\n', stop - e);
+      e = nl ? static_cast<const char *>(nl) + 1 : stop;
+    }
+    Chunk ch;
+    ch.begin = p;
+    ch.end = e;
+    ch.first = ch.lines = ch.out = 0;
+    chunks.push_back(ch);
+    p = e;
+  }
+  return false;
+}
+
+// call f(entry) for every entry of a chunk, returns true on a parse error
+template <typename F>
+static bool for_each_entry(const Chunk &ch, const Header &h, F f) {
+  const long long n = h.rows;
+
+  // array entries are located by their position, column by column
+  long long ai = 0, aj = 0;
+  if (h.format == ARRAY) {
+    long long k = ch.first;
+    if (h.symmetry == GENERAL) {
+      aj = k / n;
+      ai = k % n;
+    } else {
+      const long long off = h.symmetry == SKEW_SYMMETRIC ? 1 : 0;
+      while (k >= n - aj - off) {
+        k -= n - aj - off;
+        ++aj;
+      }
+      ai = aj + off + k;
+    }
+  }
+
+  const char *p = ch.begin;
+  while (p < ch.end) {
+    const char *eol =
+        static_cast<const char *>(std::memchr(p, '\n', ch.end - p));
+    if (!eol) eol = ch.end;
+    if (skip_line(p, eol)) {
+      p = eol + 1;
+      continue;
+    }
+
+    Entry e;
+    char *q;
+    if (h.format == COORDINATE) {
+      e.i = std::strtoll(p, &q, 10) - 1;
+      if (q == p || q > eol) return true;
+      p = q;
+      e.j = std::strtoll(p, &q, 10) - 1;
+      if (q == p || q > eol) return true;
+      p = q;
+      if (e.i < 0 || e.i >= n || e.j < 0 || e.j >= n) return true;
+    } else {
+      e.i = ai;
+      e.j = aj;
+      if (++ai == n) {
+        ++aj;
+        ai = h.symmetry == GENERAL ? 0 : aj + (h.symmetry == SKEW_SYMMETRIC);
+      }
+    }
+    if (h.field == PATTERN) {
+      e.v = 1.0;
+    } else {
+      e.v = std::strtod(p, &q);
+      if (q == p || q > eol) return true;
+    }
+
+    f(e);
+    p = eol + 1;
+  }
+  return false;
+}
+
+// count the entries of every chunk and assign their global positions
+static bool count(std::vector<Chunk> &chunks, const Header &h) {
+  const int nchunks = chunks.size();
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < nchunks; ++c) {
+    Chunk &ch = chunks[c];
+    long long lines = 0;
+    const char *p = ch.begin;
+    while (p < ch.end) {
+      const char *eol =
+          static_cast<const char *>(std::memchr(p, '\n', ch.end - p));
+      if (!eol) eol = ch.end;
+      if (!skip_line(p, eol)) ++lines;
+      p = eol + 1;
+    }
+    ch.lines = lines;
+  }
+
+  long long total = 0;
+  for (int c = 0; c < nchunks; ++c) {
+    chunks[c].first = total;
+    total += chunks[c].lines;
+  }
+  if (total != h.entries) {
+    std::cerr << "Matrix Market file has " << total << " entries, expected "
+              << h.entries << '\n';
+    return true;
+  }
+  return false;
+}
+
+// check that the sizes fit in the index type
+template <typename I>
+static bool fits(const Header &h, const long long nnz) {
+  if (h.rows >= std::numeric_limits<I>::max() ||
+      nnz > std::numeric_limits<I>::max()) {
+    std::cerr << "Matrix Market sizes overflow the index type\n";
+    return false;
+  }
+  return true;
+}
+
+// load a Matrix Market file into a coo matrix
+template <typename I>
+coo::COOMatrixT<I> *load_coo(const std::string &filename, const bool expand,
+                             Header &h, const std::size_t min_chunk) {
+  std::string buf;
+  std::vector<Chunk> chunks;
+  if (slurp(filename, min_chunk, buf, h, chunks) || count(chunks, h)) {
+    return nullptr;
+  }
+  const int nchunks = chunks.size();
+  const bool mirror = expand && h.symmetry != GENERAL;
+  const double sign = h.symmetry == SKEW_SYMMETRIC ? -1.0 : 1.0;
+
+  // mirrored off-diagonal entries need a second slot
+  bool fail = false;
+  if (mirror) {
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : fail)
+    for (int c = 0; c < nchunks; ++c) {
+      long long out = 0;
+      fail = for_each_entry(chunks[c], h, [&](const Entry &e) {
+        out += e.i == e.j ? 1 : 2;
+      }) || fail;
+      chunks[c].out = out;
+    }
+  } else {
+    for (int c = 0; c < nchunks; ++c) chunks[c].out = chunks[c].lines;
+  }
+  long long nnz = 0;
+  for (int c = 0; c < nchunks; ++c) {
+    const long long out = chunks[c].out;
+    chunks[c].out = nnz;
+    nnz += out;
+  }
+  if (fail) {
+    std::cerr << "invalid entry in Matrix Market file " << filename << '\n';
+    return nullptr;
+  }
+  if (!fits<I>(h, nnz)) return nullptr;
+
+  coo::COOMatrixT<I> *A = coo::create(I(h.rows), I(nnz));
+  if (!A) return nullptr;
+
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : fail)
+  for (int c = 0; c < nchunks; ++c) {
+    I k = I(chunks[c].out);
+    fail = for_each_entry(chunks[c], h, [&](const Entry &e) {
+      A->i[k] = I(e.i);
+      A->j[k] = I(e.j);
+      A->v[k] = e.v;
+      ++k;
+      if (mirror && e.i != e.j) {
+        A->i[k] = I(e.j);
+        A->j[k] = I(e.i);
+        A->v[k] = sign * e.v;
+        ++k;
+      }
+    }) || fail;
+  }
+  if (fail) {
+    std::cerr << "invalid entry in Matrix Market file " << filename << '\n';
+    coo::destroy(A);
+    return nullptr;
+  }
+  return A;
+}
+
+// load a Matrix Market file into a csr matrix
+template <typename I>
+csr::CSRMatrixT<I> *load_csr(const std::string &filename, const bool expand,
+                             Header &h, const std::size_t min_chunk) {
+  std::string buf;
+  std::vector<Chunk> chunks;
+  if (slurp(filename, min_chunk, buf, h, chunks) || count(chunks, h)) {
+    return nullptr;
+  }
+  const int nchunks = chunks.size();
+  const bool mirror = expand && h.symmetry != GENERAL;
+  const double sign = h.symmetry == SKEW_SYMMETRIC ? -1.0 : 1.0;
+  const long long n = h.rows;
+  if (!fits<I>(h, 0)) return nullptr;
+
+  // row lengths, shifted by one so that the prefix sum gives indptr
+  std::vector<long long> len(n + 1, 0);
+  long long *lenp = len.data();
+  bool fail = false;
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : fail)
+  for (int c = 0; c < nchunks; ++c) {
+    fail = for_each_entry(chunks[c], h, [&](const Entry &e) {
+#pragma omp atomic
+      ++lenp[e.i + 1];
+      if (mirror && e.i != e.j) {
+#pragma omp atomic
+        ++lenp[e.j + 1];
+      }
+    }) || fail;
+  }
+  if (fail) {
+    std::cerr << "invalid entry in Matrix Market file " << filename << '\n';
+    return nullptr;
+  }
+  for (long long i = 0; i < n; ++i) len[i + 1] += len[i];
+  if (!fits<I>(h, len[n])) return nullptr;
+
+  csr::CSRMatrixT<I> *A = csr::create(I(n), I(len[n]));
+  if (!A) return nullptr;
+
+  // next free slot of every row
+  I *cursor = new I[n];
+  for (long long i = 0; i <= n; ++i) A->indptr[i] = I(len[i]);
+  std::copy(A->indptr, A->indptr + n, cursor);
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < nchunks; ++c) {
+    for_each_entry(chunks[c], h, [&](const Entry &e) {
+      I k;
+#pragma omp atomic capture
+      k = cursor[e.i]++;
+      A->indices[k] = I(e.j);
+      A->value[k] = e.v;
+      if (mirror && e.i != e.j) {
+#pragma omp atomic capture
+        k = cursor[e.j]++;
+        A->indices[k] = I(e.i);
+        A->value[k] = sign * e.v;
+      }
+    });
+  }
+  delete[] cursor;
+
+  // chunks fill rows in any order, sort the columns of every row
+#pragma omp parallel
+  {
+    std::vector<std::pair<I, double> > row;
+#pragma omp for schedule(dynamic, 256)
+    for (long long i = 0; i < n; ++i) {
+      const I b = A->indptr[i], e = A->indptr[i + 1];
+      row.clear();
+      for (I k = b; k < e; ++k) {
+        row.push_back(std::make_pair(A->indices[k], A->value[k]));
+      }
+      std::sort(row.begin(), row.end());
+      for (I k = b; k < e; ++k) {
+        A->indices[k] = row[k - b].first;
+        A->value[k] = row[k - b].second;
+      }
+    }
+  }
+  return A;
+}
+
+// entries per part of the writers
+static const long long WRITE_PART = 1 << 16;
+
+// format the entries of every part in parallel and write them in order,
+// part(p, out) appends the lines of part p and returns their count
+template <typename F>
+static bool write_parts(const std::string &filename, const long long nparts,
+                        const Header &h, F part) {
+  std::ofstream f(filename.c_str(), std::ios::binary);
+  if (!f.is_open()) {
+    std::cerr << "cannot open file " << filename << '\n';
+    return true;
+  }
+
+  std::vector<std::string> text(nparts);
+  std::vector<long long> lines(nparts);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (long long p = 0; p < nparts; ++p) {
+    lines[p] = part(p, text[p]);
+  }
+  long long total = 0;
+  for (long long p = 0; p < nparts; ++p) total += lines[p];
+
+  const char *formats[] = {"coordinate", "array"};
+  const char *fields[] = {"real", "integer", "pattern"};
+  const char *symmetries[] = {"general", "symmetric", "skew-symmetric"};
+  f << "%%MatrixMarket matrix " << formats[h.format] << ' '
+    << fields[h.field] << ' ' << symmetries[h.symmetry] << '\n'
+    << h.rows << ' ' << h.cols;
+  if (h.format == COORDINATE) f << ' ' << total;
+  f << '\n';
+  for (long long p = 0; p < nparts; ++p) f << text[p];
+  return !f;
+}
+
+// append a value in the field of the file, integers are rounded
+static void format_value(std::string &out, const double v, const Field field) {
+  char buf[32];
+  const int len = field == INTEGER
+                      ? std::snprintf(buf, sizeof(buf), "%lld", std::llround(v))
+                      : std::snprintf(buf, sizeof(buf), "%.17g", v);
+  out.append(buf, len);
+}
+
+// append one 1-based coordinate entry if the symmetry keeps it
+static long long format_entry(std::string &out, const long long i,
+                        const long long j, const double v, const Header &h) {
+  if (h.symmetry == SYMMETRIC && j > i) return 0;
+  if (h.symmetry == SKEW_SYMMETRIC && j >= i) return 0;
+  char buf[48];
+  out.append(buf, std::snprintf(buf, sizeof(buf), "%lld %lld", i + 1, j + 1));
+  if (h.field != PATTERN) {
+    out += ' ';
+    format_value(out, v, h.field);
+  }
+  out += '\n';
+  return 1;
+}
+
+// fill the header of a file to write, array files cannot be pattern
+static bool layout(Header &h, const long long n, const Symmetry symmetry,
+                   const Field field, const Format format) {
+  if (format == ARRAY && field == PATTERN) {
+    std::cerr << "array Matrix Market files cannot be pattern\n";
+    return true;
+  }
+  h.format = format;
+  h.field = field;
+  h.symmetry = symmetry;
+  h.rows = h.cols = n;
+  h.entries = 0;
+  return false;
+}
+
+// write every position of the stored part column by column, missing
+// entries are written as zeros and duplicates are summed; each(f) calls
+// f(i, j, v) for every entry
+template <typename E>
+static bool write_array(const std::string &filename, const Header &h,
+                        const long long nnz, E each) {
+  const long long n = h.rows;
+
+  // counting sort of the entries by column
+  std::vector<long long> ptr(n + 1, 0), row(nnz);
+  std::vector<double> val(nnz);
+  each([&](const long long, const long long j, const double) {
+    ++ptr[j + 1];
+  });
+  for (long long j = 0; j < n; ++j) ptr[j + 1] += ptr[j];
+  std::vector<long long> pos(ptr.begin(), ptr.end() - 1);
+  each([&](const long long i, const long long j, const double v) {
+    row[pos[j]] = i;
+    val[pos[j]++] = v;
+  });
+
+  // first stored row of column j is j+off
+  const long long off = h.symmetry == SKEW_SYMMETRIC ? 1 : 0;
+  const long long cols = std::max(1LL, WRITE_PART / n);
+  const long long nparts = (n + cols - 1) / cols;
+  return write_parts(
+      filename, nparts, h, [&](const long long p, std::string &out) {
+        std::vector<double> dense(n);
+        long long lines = 0;
+        const long long e = std::min(n, (p + 1) * cols);
+        for (long long j = p * cols; j < e; ++j) {
+          std::fill(dense.begin(), dense.end(), 0.0);
+          for (long long k = ptr[j]; k < ptr[j + 1]; ++k) {
+            dense[row[k]] += val[k];
+          }
+          const long long first = h.symmetry == GENERAL ? 0 : j + off;
+          for (long long i = first; i < n; ++i, ++lines) {
+            format_value(out, dense[i], h.field);
+            out += '\n';
+          }
+        }
+        return lines;
+      });
+}
+
+// write a coo matrix
+template <typename I>
+bool write(const std::string &filename, const coo::COOMatrixT<I> &A,
+           const Symmetry symmetry, const Field field, const Format format) {
+  Header h;
+  if (layout(h, A.n, symmetry, field, format)) return true;
+  const long long nnz = A.nnz;
+  if (format == ARRAY) {
+    return write_array(filename, h, nnz, [&](
+        const std::function<void(long long, long long, double)> &f) {
+      for (long long k = 0; k < nnz; ++k) f(A.i[k], A.j[k], A.v[k]);
+    });
+  }
+  const long long nparts = (nnz + WRITE_PART - 1) / WRITE_PART;
+  return write_parts(
+      filename, nparts, h, [&](const long long p, std::string &out) {
+        long long lines = 0;
+        const long long e = std::min(nnz, (p + 1) * WRITE_PART);
+        for (long long k = p * WRITE_PART; k < e; ++k) {
+          lines += format_entry(out, A.i[k], A.j[k], A.v[k], h);
+        }
+        return lines;
+      });
+}
+
+// write a csr matrix
+template <typename I>
+bool write(const std::string &filename, const csr::CSRMatrixT<I> &A,
+           const Symmetry symmetry, const Field field, const Format format) {
+  Header h;
+  const long long n = A.n;
+  if (layout(h, n, symmetry, field, format)) return true;
+  if (format == ARRAY) {
+    return write_array(filename, h, A.indptr[n], [&](
+        const std::function<void(long long, long long, double)> &f) {
+      for (long long i = 0; i < n; ++i) {
+        for (I k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+          f(i, A.indices[k], A.value[k]);
+        }
+      }
+    });
+  }
+  const long long nparts = (n + WRITE_PART - 1) / WRITE_PART;
+  return write_parts(
+      filename, nparts, h, [&](const long long p, std::string &out) {
+        long long lines = 0;
+        const long long e = std::min(n, (p + 1) * WRITE_PART);
+        for (long long i = p * WRITE_PART; i < e; ++i) {
+          for (I k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+            lines += format_entry(out, i, A.indices[k], A.value[k], h);
+          }
+        }
+        return lines;
+      });
+}
+
+// instantiations
+template coo::COOMatrixT<std::int32_t> *load_coo(const std::string &filename,
+                                                 const bool expand, Header &h,
+                                                 const std::size_t min_chunk);
+template coo::COOMatrixT<std::int64_t> *load_coo(const std::string &filename,
+                                                 const bool expand, Header &h,
+                                                 const std::size_t min_chunk);
+template csr::CSRMatrixT<std::int32_t> *load_csr(const std::string &filename,
+                                                 const bool expand, Header &h,
+                                                 const std::size_t min_chunk);
+template csr::CSRMatrixT<std::int64_t> *load_csr(const std::string &filename,
+                                                 const bool expand, Header &h,
+                                                 const std::size_t min_chunk);
+template bool write(const std::string &filename,
+                    const coo::COOMatrixT<std::int32_t> &A,
+                    const Symmetry symmetry, const Field field,
+                    const Format format);
+template bool write(const std::string &filename,
+                    const coo::COOMatrixT<std::int64_t> &A,
+                    const Symmetry symmetry, const Field field,
+                    const Format format);
+template bool write(const std::string &filename,
+                    const csr::CSRMatrixT<std::int32_t> &A,
+                    const Symmetry symmetry, const Field field,
+                    const Format format);
+template bool write(const std::string &filename,
+                    const csr::CSRMatrixT<std::int64_t> &A,
+                    const Symmetry symmetry, const Field field,
+                    const Format format);
+
+}  // namespace mm
@@ -0,0 +1,113 @@
+// This is part of AMS562 midterm project
+
+/// \brief Matrix Market (.mtx) reader and writer
+
+#ifndef _MMIO_HPP
+#define _MMIO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "coo.hpp"
+#include "csr.hpp"
+
+namespace mm {
+
+/// \brief storage layout of the data section
+enum Format { COORDINATE, ARRAY };
+
+/// \brief type of the values, pattern files have no values
+enum Field { REAL, INTEGER, PATTERN };
+
+/// \brief symmetry of the matrix, only the lower triangle is stored for
+///        symmetric and skew-symmetric files
+enum Symmetry { GENERAL, SYMMETRIC, SKEW_SYMMETRIC };
+
+/// \struct Header
+/// \brief banner and size line of a Matrix Market file
+struct Header {
+  Format format;       ///< coordinate or array
+  Field field;         ///< real, integer or pattern
+  Symmetry symmetry;   ///< general, symmetric or skew-symmetric
+  long long rows;      ///< number of rows
+  long long cols;      ///< number of columns
+  long long entries;   ///< number of stored entries in the data section
+};
+
+/// \brief read the banner and size line only
+/// \param[in] filename Matrix Market file
+/// \param[out] h header
+/// \return \a true if things go wrong, \a false ew
+///
+/// Complex and hermitian files and non-square matrices are rejected.
+bool read_header(const std::string &filename, Header &h);
+
+/// \brief load a Matrix Market file into a coo matrix
+/// \param[in] filename Matrix Market file
+/// \param[in] expand mirror the stored triangle of symmetric files
+/// \param[out] h header of the file
+/// \param[in] min_chunk smallest chunk of the data section in bytes
+/// \return COO matrix pointer, \a nullptr if things go wrong
+/// \sa coo::destroy
+///
+/// The file is read at once and its data section is cut at line ends into
+/// up to four chunks per thread, none smaller than \a min_chunk. A first
+/// pass counts the entries of every chunk, a second one parses each chunk
+/// straight into its slice of the output arrays. Indices are converted to
+/// 0-based. Pattern entries get the value 1. If \a expand is \a false,
+/// symmetric files keep their stored triangle and h.symmetry tells how to
+/// apply them, see csr::mv_sym.
+template <typename I = std::int32_t>
+coo::COOMatrixT<I> *load_coo(const std::string &filename, const bool expand,
+                             Header &h, const std::size_t min_chunk = 1 << 16);
+
+/// \brief load a Matrix Market file into a csr matrix
+/// \param[in] filename Matrix Market file
+/// \param[in] expand mirror the stored triangle of symmetric files
+/// \param[out] h header of the file
+/// \param[in] min_chunk smallest chunk of the data section in bytes
+/// \return CSR matrix pointer, \a nullptr if things go wrong
+/// \sa csr::destroy
+///
+/// Same as load_coo, except that the first pass also counts the row
+/// lengths, and the second one places each entry at its position in the
+/// row. Columns are sorted within each row.
+template <typename I = std::int32_t>
+csr::CSRMatrixT<I> *load_csr(const std::string &filename, const bool expand,
+                             Header &h, const std::size_t min_chunk = 1 << 16);
+
+/// \brief write a coo matrix
+/// \param[in] filename output file
+/// \param[in] A input coo matrix
+/// \param[in] symmetry \a GENERAL writes every entry, otherwise only the
+///            lower (strictly lower for skew-symmetric) triangle is written
+/// \param[in] field \a INTEGER rounds the values, \a PATTERN drops them
+/// \param[in] format \a ARRAY writes every position of the stored part
+///            column by column, with zeros for missing entries
+/// \return \a true if things go wrong, \a false ew
+///
+/// Array files cannot be pattern. Duplicate entries are summed in array
+/// files and written as they are in coordinate files.
+template <typename I>
+bool write(const std::string &filename, const coo::COOMatrixT<I> &A,
+           const Symmetry symmetry = GENERAL, const Field field = REAL,
+           const Format format = COORDINATE);
+
+/// \brief write a csr matrix
+/// \param[in] filename output file
+/// \param[in] A input csr matrix
+/// \param[in] symmetry \a GENERAL writes every entry, otherwise only the
+///            lower (strictly lower for skew-symmetric) triangle is written
+/// \param[in] field \a INTEGER rounds the values, \a PATTERN drops them
+/// \param[in] format \a ARRAY writes every position of the stored part
+///            column by column, with zeros for missing entries
+/// \return \a true if things go wrong, \a false ew
+template <typename I>
+bool write(const std::string &filename, const csr::CSRMatrixT<I> &A,
+           const Symmetry symmetry = GENERAL, const Field field = REAL,
+           const Format format = COORDINATE);
+
+}  // namespace mm
+
+#endif
@@ -0,0 +1,199 @@
+// This is the source file that contains the implementation of
+// the mixed-precision iterative refinement
+
+#include "mpir.hpp"
+#include "csr.hpp"
+#include "vec.hpp"
+
+#include <cmath>
+#include <iostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace mpir {
+
+// number of vectors of the inner BiCGSTAB: d, rhs, r, rhat, p, v, s, t
+static const int NVEC = 8;
+
+// relative tolerance of the inner solves, float reaches about 1e-6
+static const double FLOAT_TOL = 1e-5;
+static const double DOUBLE_TOL = 1e-10;
+
+static const int MAX_OUTER = 50;
+static const int MAX_INNER = 1000;
+
+// a refinement step stalls if it does not halve the residual
+static const double STALL = 0.5;
+
+// matrix vector multiplication in the working precision T
+template <typename T>
+static void spmv(const csr::CSRMatrix &A, const T *value, const T *x, T *y) {
+  const int n = A.n;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) {
+    T sum = 0;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      sum += value[k] * x[A.indices[k]];
+    }
+    y[i] = sum;
+  }
+}
+
+// dot products are accumulated in double for both precisions
+template <typename T>
+static double dot(const T *x, const T *y, const int n) {
+  double sum = 0.0;
+#pragma omp parallel for reduction(+ : sum) schedule(static)
+  for (int i = 0; i < n; ++i) sum += double(x[i]) * double(y[i]);
+  return sum;
+}
+
+// BiCGSTAB from a zero initial guess, the solution is w[0] and the rhs is
+// w[1]; returns the number of iterations
+template <typename T>
+static int bicgstab(const csr::CSRMatrix &A, const T *value, T *const *w,
+                    const double tol) {
+  const int n = A.n;
+  T *d = w[0], *rhs = w[1], *r = w[2], *rhat = w[3], *p = w[4], *v = w[5],
+    *s = w[6], *t = w[7];
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) {
+    d[i] = p[i] = v[i] = 0;
+    r[i] = rhat[i] = rhs[i];
+  }
+
+  const double bound = tol * std::sqrt(dot(rhs, rhs, n));
+  double rho = 1.0, alpha = 1.0, omega = 1.0;
+  int it = 0;
+  while (it < MAX_INNER) {
+    ++it;
+    const double rho_new = dot(rhat, r, n);
+    if (rho_new == 0.0 || !std::isfinite(rho_new)) break;
+    const T beta = T((rho_new / rho) * (alpha / omega));
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) p[i] = r[i] + beta * (p[i] - T(omega) * v[i]);
+    spmv(A, value, p, v);
+
+    const double den = dot(rhat, v, n);
+    alpha = rho_new / den;
+    if (den == 0.0 || !std::isfinite(alpha)) break;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) s[i] = r[i] - T(alpha) * v[i];
+    if (std::sqrt(dot(s, s, n)) <= bound) {
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < n; ++i) d[i] += T(alpha) * p[i];
+      break;
+    }
+
+    spmv(A, value, s, t);
+    const double tt = dot(t, t, n);
+    omega = tt > 0.0 ? dot(t, s, n) / tt : 0.0;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+      d[i] += T(alpha) * p[i] + T(omega) * s[i];
+      r[i] = s[i] - T(omega) * t[i];
+    }
+    if (omega == 0.0 || std::sqrt(dot(r, r, n)) <= bound) break;
+    rho = rho_new;
+  }
+  return it;
+}
+
+// one refinement step: x += ||r|| * A^{-1}(r/||r||) in precision T; the
+// scaling keeps the float rhs away from underflow as the residual shrinks
+template <typename T>
+static int correct(const Solver &s, const T *value, T *work, const double rn,
+                   double *x) {
+  const int n = s.n;
+  T *w[NVEC];
+  for (int v = 0; v < NVEC; ++v) w[v] = work + v * n;
+  const double *r = s.r->value;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) w[1][i] = T(r[i] / rn);
+
+  const int it = bicgstab(*s.A, value, w, sizeof(T) < sizeof(double)
+                                               ? FLOAT_TOL
+                                               : DOUBLE_TOL);
+  for (int i = 0; i < n; ++i) {
+    if (!std::isfinite(double(w[0][i]))) return it;  // leave x untouched
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) x[i] += rn * double(w[0][i]);
+  return it;
+}
+
+// r = b - Ax in double, returns ||r||
+static double residual(const Solver &s, const vec::DenseVec &b,
+                       const vec::DenseVec &x) {
+  csr::mv(*s.A, x, *s.r);
+  double *r = s.r->value;
+  const int n = s.n;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; ++i) r[i] = b.value[i] - r[i];
+  return std::sqrt(dot(r, r, n));
+}
+
+// create a solver
+Solver *create(const csr::CSRMatrix &A) {
+  const int n = A.n;
+  if (n <= 0) {
+    std::cout << "Invalid matrix shape" << "\n";
+    return nullptr;
+  }
+
+  Solver *s = new Solver;
+  s->A = &A;
+  s->n = n;
+  const int nnz = A.indptr[n];
+  s->value = new float[nnz];
+  for (int k = 0; k < nnz; ++k) s->value[k] = float(A.value[k]);
+  s->fwork = new float[NVEC * std::size_t(n)];
+  s->dwork = new double[NVEC * std::size_t(n)];
+  s->r = vec::create(n);
+  return s;
+}
+
+// destroy a solver
+void destroy(Solver *s) {
+  if (!s) return;
+  delete[] s->value;
+  delete[] s->fwork;
+  delete[] s->dwork;
+  vec::destroy(s->r);
+  delete s;
+}
+
+// solve Ax=b by iterative refinement
+bool solve(const Solver &s, const vec::DenseVec &b, vec::DenseVec &x,
+           const double tol, Info &info, const bool mixed) {
+  if (b.n != s.n || x.n != s.n) return true;
+
+  info.outer = info.inner = 0;
+  info.fallback = false;
+  const double bn = std::sqrt(dot(b.value, b.value, s.n));
+  if (bn == 0.0) {
+    for (int i = 0; i < s.n; ++i) x.value[i] = 0.0;
+    info.residual = 0.0;
+    return false;
+  }
+
+  bool single = mixed;
+  double rn = residual(s, b, x);
+  while (rn > tol * bn && info.outer < MAX_OUTER) {
+    ++info.outer;
+    info.inner += single ? correct(s, s.value, s.fwork, rn, x.value)
+                         : correct(s, s.A->value, s.dwork, rn, x.value);
+    const double prev = rn;
+    rn = residual(s, b, x);
+    if (single && !(rn <= STALL * prev)) {
+      single = false;
+      info.fallback = true;
+    }
+  }
+  info.residual = rn / bn;
+  return !(rn <= tol * bn);
+}
+
+}  // namespace mpir
@@ -0,0 +1,78 @@
+// This is part of AMS562 midterm project
+
+/// \brief Mixed-precision iterative refinement around csr::mv
+
+#ifndef _MPIR_HPP
+#define _MPIR_HPP
+
+#include <cstdint>
+
+// declaration
+namespace vec {
+template <typename I>
+struct DenseVecT;
+typedef DenseVecT<std::int32_t> DenseVec;
+}
+
+namespace csr {
+template <typename I>
+struct CSRMatrixT;
+typedef CSRMatrixT<std::int32_t> CSRMatrix;
+}
+
+namespace mpir {
+
+/// \struct Solver
+/// \brief float copy of a matrix plus the buffers of the refinement
+///
+/// The float copy only holds the values, the index arrays are shared with
+/// the double matrix. The inner BiCGSTAB runs on the float copy; the outer
+/// residuals b-Ax are computed in double with csr::mv.
+struct Solver {
+  const csr::CSRMatrix *A;  ///< double matrix, must outlive the solver
+  float *value;             ///< float copy of the values of A
+  float *fwork;             ///< float BiCGSTAB vectors
+  double *dwork;            ///< double BiCGSTAB vectors of the fallback
+  vec::DenseVec *r;         ///< outer residual
+  int n;                    ///< size of the square matrix
+};
+
+/// \struct Info
+/// \brief convergence history of one solve
+struct Info {
+  int outer;        ///< number of refinement steps
+  int inner;        ///< total number of inner BiCGSTAB iterations
+  bool fallback;    ///< \a true if the inner solver switched to double
+  double residual;  ///< final relative residual ||b-Ax||/||b||
+};
+
+/// \brief create a solver
+/// \param[in] A input csr matrix
+/// \return solver pointer, \a nullptr if things go wrong
+/// \sa destroy
+Solver *create(const csr::CSRMatrix &A);
+
+/// \brief destroy a solver
+/// \param[in] s solver that is allocated by create
+void destroy(Solver *s);
+
+/// \brief solve Ax=b by iterative refinement
+/// \param[in] s solver of \a A
+/// \param[in] b input rhs vector
+/// \param[in,out] x initial guess on input, solution on output
+/// \param[in] tol target relative residual ||b-Ax||/||b||
+/// \param[out] info convergence history
+/// \param[in] mixed \a false runs the inner solver in double from the start
+/// \return \a true if things go wrong, \a false ew
+///
+/// Each step solves A d = r/||r|| roughly in float and adds the scaled
+/// correction to x. When a step reduces the residual by less than half, or
+/// the float solver breaks down, the remaining steps use the double inner
+/// solver. The solver holds the work buffers, so it must not be shared by
+/// concurrent calls.
+bool solve(const Solver &s, const vec::DenseVec &b, vec::DenseVec &x,
+           const double tol, Info &info, const bool mixed = true);
+
+}  // namespace mpir
+
+#endif
@@ -0,0 +1,319 @@
+// This is the source file that contains the implementation of
+// the work-stealing thread pool
+
+#include "pool.hpp"
+#include "csr.hpp"
+#include "vec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pool {
+
+// slots per worker queue, must be a power of two
+static const size_t QUEUE_SIZE = 1024;
+
+// smallest task worth handing to another thread, in non-zeros plus rows
+static const int MIN_TASK_WORK = 1 << 14;
+
+// tasks per worker a large product is split into
+static const int TASKS_PER_WORKER = 4;
+
+// failed polls before an idle worker parks
+static const int SPIN_LIMIT = 256;
+
+/// \struct Future
+/// \brief completion counter of a submitted product
+struct Future {
+  Pool *p;                   ///< pool the tasks were submitted to
+  std::atomic<int> pending;  ///< tasks not finished yet
+};
+
+/// \struct Task
+/// \brief a range of rows of one product
+struct Task {
+  const csr::CSRMatrix *A;  ///< input matrix
+  const double *x;          ///< rhs values
+  double *y;                ///< lhs values
+  int begin;                ///< first row
+  int end;                  ///< one past the last row
+  Future *f;                ///< future to signal
+};
+
+/// \struct Cell
+/// \brief queue slot, seq tells whose turn it is
+struct Cell {
+  std::atomic<size_t> seq;
+  Task task;
+};
+
+/// \struct Queue
+/// \brief bounded lock-free multi-producer multi-consumer queue
+///
+/// Each slot carries a sequence number, producers and consumers claim a
+/// position with a single compare-and-swap and publish through the slot.
+struct Queue {
+  Cell *cells;
+  char pad0[64];
+  std::atomic<size_t> head;  ///< next position to push
+  char pad1[64];
+  std::atomic<size_t> tail;  ///< next position to pop
+  char pad2[64];
+};
+
+/// \struct Pool
+/// \brief worker threads and their queues
+struct Pool {
+  std::vector<std::thread> threads;  ///< workers
+  Queue *queues;                     ///< one queue per worker
+  int nqueues;                       ///< number of queues
+  std::atomic<unsigned> next;        ///< round-robin start of submissions
+  std::atomic<bool> stop;            ///< set by destroy
+  std::atomic<unsigned> epoch;       ///< bumped after every submission
+  std::atomic<int> sleepers;         ///< parked workers
+  std::mutex park_lock;              ///< guards the parking of workers
+  std::condition_variable park;      ///< parked workers wait here
+};
+
+static bool push(Queue &q, const Task &t) {
+  size_t pos = q.head.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &c = q.cells[pos & (QUEUE_SIZE - 1)];
+    const size_t seq = c.seq.load(std::memory_order_acquire);
+    const std::ptrdiff_t dif = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+    if (dif == 0) {
+      if (q.head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+        c.task = t;
+        c.seq.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (dif < 0) {
+      return false;  // full
+    } else {
+      pos = q.head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+static bool pop(Queue &q, Task &t) {
+  size_t pos = q.tail.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &c = q.cells[pos & (QUEUE_SIZE - 1)];
+    const size_t seq = c.seq.load(std::memory_order_acquire);
+    const std::ptrdiff_t dif = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+    if (dif == 0) {
+      if (q.tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+        t = c.task;
+        c.seq.store(pos + QUEUE_SIZE, std::memory_order_release);
+        return true;
+      }
+    } else if (dif < 0) {
+      return false;  // empty
+    } else {
+      pos = q.tail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// pop from queue `first`, then steal from the others
+static bool take(Pool &p, const int first, Task &t) {
+  for (int k = 0; k < p.nqueues; ++k) {
+    if (pop(p.queues[(first + k) % p.nqueues], t)) return true;
+  }
+  return false;
+}
+
+static void run(const Task &t) {
+  const csr::CSRMatrix &A = *t.A;
+  for (int i = t.begin; i < t.end; ++i) {
+    double sum = 0.0;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      sum += A.value[k] * t.x[A.indices[k]];
+    }
+    t.y[i] = sum;
+  }
+  t.f->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// wake up to \a ntasks parked workers after tasks were queued
+static void wake(Pool &p, const int ntasks) {
+  p.epoch.fetch_add(1);
+  const int sleepers = p.sleepers.load();
+  if (sleepers == 0) return;  // the common case takes no lock
+  // a worker between its epoch check and its wait holds the lock, so taking
+  // it here makes sure the notification is not lost
+  { std::lock_guard<std::mutex> lock(p.park_lock); }
+  for (int k = 0; k < std::min(ntasks, sleepers); ++k) p.park.notify_one();
+}
+
+static void worker(Pool *p, const int id) {
+  Task t;
+  int idle = 0;
+  while (true) {
+    // read before polling, a submission after the poll changes it
+    const unsigned epoch = p->epoch.load();
+    if (take(*p, id, t)) {
+      run(t);
+      idle = 0;
+      continue;
+    }
+    if (p->stop.load(std::memory_order_acquire)) return;
+    if (++idle < SPIN_LIMIT) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(p->park_lock);
+    p->sleepers.fetch_add(1);
+    while (p->epoch.load() == epoch && !p->stop.load()) p->park.wait(lock);
+    p->sleepers.fetch_sub(1);
+    idle = 0;
+  }
+}
+
+// create a pool
+Pool *create(const int nthreads) {
+  if (nthreads <= 0) return nullptr;
+
+  Pool *p = new Pool;
+  p->nqueues = nthreads;
+  p->queues = new Queue[nthreads];
+  for (int k = 0; k < nthreads; ++k) {
+    Queue &q = p->queues[k];
+    q.cells = new Cell[QUEUE_SIZE];
+    for (size_t i = 0; i < QUEUE_SIZE; ++i) {
+      q.cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    q.head.store(0, std::memory_order_relaxed);
+    q.tail.store(0, std::memory_order_relaxed);
+  }
+  p->next.store(0);
+  p->stop.store(false);
+  p->epoch.store(0);
+  p->sleepers.store(0);
+  for (int k = 0; k < nthreads; ++k) {
+    p->threads.push_back(std::thread(worker, p, k));
+  }
+  return p;
+}
+
+// destroy a pool
+void destroy(Pool *p) {
+  if (!p) return;
+  p->stop.store(true, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(p->park_lock);
+    p->park.notify_all();
+  }
+  for (unsigned k = 0; k < p->threads.size(); ++k) p->threads[k].join();
+  for (int k = 0; k < p->nqueues; ++k) delete[] p->queues[k].cells;
+  delete[] p->queues;
+  delete p;
+}
+
+// owner of the library-wide pool
+struct Shared {
+  Pool *p;
+  Shared() {
+    const int n = std::thread::hardware_concurrency();
+    p = create(n > 0 ? n : 1);
+  }
+  ~Shared() { destroy(p); }
+};
+
+Pool &shared() {
+  static Shared s;
+  return *s.p;
+}
+
+// first row r > begin with indptr[r]+r >= target, or n
+static int split(const csr::CSRMatrix &A, const int begin, const long target) {
+  int lo = begin + 1, hi = A.n;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (long(A.indptr[mid]) + mid >= target) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+// submit a matrix vector multiplication
+Future *submit_mv(Pool &p, const csr::CSRMatrix &A, const vec::DenseVec &x,
+                  vec::DenseVec &y) {
+  if (x.n != A.n || y.n != A.n) return nullptr;
+  const int n = A.n;
+
+  // weigh rows as well as non-zeros, so empty rows are not free
+  const long work = long(A.indptr[n]) + n;
+  const long grain = std::max(long(MIN_TASK_WORK),
+                              work / (long(p.nqueues) * TASKS_PER_WORKER));
+
+  Future *f = new Future;
+  f->p = &p;
+  // hold one extra count so tasks finishing early cannot complete it
+  f->pending.store(1, std::memory_order_relaxed);
+
+  Task t;
+  t.A = &A;
+  t.x = x.value;
+  t.y = y.value;
+  t.f = f;
+  unsigned q = p.next.fetch_add(1, std::memory_order_relaxed);
+  int queued_tasks = 0;
+  for (int begin = 0; begin < n; begin = t.end) {
+    t.begin = begin;
+    t.end = split(A, begin, long(A.indptr[begin]) + begin + grain);
+    f->pending.fetch_add(1, std::memory_order_relaxed);
+
+    bool queued = false;
+    for (int k = 0; k < p.nqueues && !queued; ++k, ++q) {
+      queued = push(p.queues[q % p.nqueues], t);
+    }
+    if (queued) {
+      ++queued_tasks;
+    } else {
+      run(t);
+    }
+  }
+  if (queued_tasks) wake(p, queued_tasks);
+  f->pending.fetch_sub(1, std::memory_order_acq_rel);
+  return f;
+}
+
+bool ready(const Future &f) {
+  return f.pending.load(std::memory_order_acquire) == 0;
+}
+
+// wait for a product and release its future
+bool wait(Future *f) {
+  if (!f) return true;
+  Task t;
+  unsigned first = 0;
+  while (!ready(*f)) {
+    // help instead of idling, this also bounds latency when all workers
+    // are busy with other products
+    if (take(*f->p, first++ % f->p->nqueues, t)) {
+      run(t);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  delete f;
+  return false;
+}
+
+// matrix vector multiplication on the shared pool
+bool mv(const csr::CSRMatrix &A, const vec::DenseVec &x, vec::DenseVec &y) {
+  return wait(submit_mv(shared(), A, x, y));
+}
+
+}  // namespace pool
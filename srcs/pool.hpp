@@ -0,0 +1,86 @@
+// This is part of AMS562 midterm project
+
+/// \brief Shared work-stealing thread pool for concurrent products
+
+#ifndef _POOL_HPP
+#define _POOL_HPP
+
+#include <cstdint>
+
+// declaration
+namespace vec {
+template <typename I>
+struct DenseVecT;
+typedef DenseVecT<std::int32_t> DenseVec;
+}
+
+namespace csr {
+template <typename I>
+struct CSRMatrixT;
+typedef CSRMatrixT<std::int32_t> CSRMatrix;
+}
+
+namespace pool {
+
+/// \struct Pool
+/// \brief opaque handle of a set of worker threads
+///
+/// Every worker owns a bounded lock-free queue. Submitters spread the tasks
+/// of a product over the queues, idle workers steal from the other queues.
+/// Workers that stay idle park on a condition variable until the next
+/// submission, so an unused pool costs no CPU time.
+struct Pool;
+
+/// \struct Future
+/// \brief opaque handle of a submitted product
+struct Future;
+
+/// \brief create a pool
+/// \param[in] nthreads number of worker threads
+/// \return pool pointer, \a nullptr if \a nthreads is not positive
+/// \sa destroy
+Pool *create(const int nthreads);
+
+/// \brief destroy a pool, pending tasks are finished first
+/// \param[in] p pool that is allocated by create
+void destroy(Pool *p);
+
+/// \brief library-wide pool with one worker per hardware thread
+/// \note It is created on first use and destroyed at program exit.
+Pool &shared();
+
+/// \brief submit a matrix vector multiplication
+/// \param[in] p pool that runs the product
+/// \param[in] A input csr matrix
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \return future pointer, \a nullptr if the sizes don't match
+/// \sa wait
+///
+/// The rows are split into tasks of balanced non-zero plus row counts.
+/// Submission never blocks; when all queues are full the task runs on the
+/// calling thread. \a A, \a x and \a y must stay alive until wait returns.
+Future *submit_mv(Pool &p, const csr::CSRMatrix &A, const vec::DenseVec &x,
+                  vec::DenseVec &y);
+
+/// \brief check whether a product has finished
+/// \param[in] f future returned by submit_mv
+bool ready(const Future &f);
+
+/// \brief wait for a product and release its future
+/// \param[in] f future returned by submit_mv
+/// \return \a true if things go wrong, \a false ew
+///
+/// The calling thread runs queued tasks while it waits.
+bool wait(Future *f);
+
+/// \brief matrix vector multiplication on the shared pool
+/// \param[in] A input csr matrix
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \return \a true if things go wrong, \a false ew
+bool mv(const csr::CSRMatrix &A, const vec::DenseVec &x, vec::DenseVec &y);
+
+}  // namespace pool
+
+#endif
@@ -0,0 +1,32 @@
+// This is the source file that contains the non-template part of
+// StencilMatrix support
+
+#include "stencil.hpp"
+
+#include <algorithm>
+
+namespace stencil {
+
+// collect the distinct diagonal offsets
+bool detect_offsets(const csr::CSRMatrix &A, std::vector<int> &offsets) {
+  if (A.n <= 0) return true;
+  offsets.clear();
+  size_t limit = 4096;
+  for (int i = 0; i < A.n; ++i) {
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      offsets.push_back(A.indices[k] - i);
+    }
+    // keep the buffer small for banded matrices
+    if (offsets.size() > limit) {
+      std::sort(offsets.begin(), offsets.end());
+      offsets.erase(std::unique(offsets.begin(), offsets.end()),
+                    offsets.end());
+      limit = 2 * offsets.size() + 4096;
+    }
+  }
+  std::sort(offsets.begin(), offsets.end());
+  offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+  return false;
+}
+
+}  // namespace stencil
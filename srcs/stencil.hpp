@@ -0,0 +1,193 @@
+// This is part of AMS562 midterm project
+
+/// \brief Diagonal storage for constant-offset stencil matrices
+
+#ifndef _STENCIL_HPP
+#define _STENCIL_HPP
+
+#include <iostream>
+#include <vector>
+
+#include "csr.hpp"
+#include "vec.hpp"
+
+namespace stencil {
+
+/// \struct StencilMatrix
+/// \brief structure of diagonal (DIA) representation with fixed offsets
+///
+/// Entry (i, i+Offs[k]) is stored at value[k*n+i]; entries that fall outside
+/// of the matrix are stored as zeros. Since the offsets are template
+/// parameters, no index array is stored or loaded.
+template <int... Offs>
+struct StencilMatrix {
+  double *value;  ///< diagonal data array of length n*sizeof...(Offs)
+  int n;          ///< size of the square matrix
+};
+
+/// \brief 5-point stencil on a 2D grid with \a NX points per line
+template <int NX>
+using Stencil5 = StencilMatrix<-NX, -1, 0, 1, NX>;
+
+/// \brief 7-point stencil on a 3D grid with \a NX x \a NY points per plane
+template <int NX, int NY>
+using Stencil7 = StencilMatrix<-NX * NY, -NX, -1, 0, 1, NX, NX * NY>;
+
+/// \brief 27-point stencil on a 3D grid with \a NX x \a NY points per plane
+template <int NX, int NY>
+using Stencil27 = StencilMatrix<
+    -NX * NY - NX - 1, -NX * NY - NX, -NX * NY - NX + 1, -NX * NY - 1,
+    -NX * NY, -NX * NY + 1, -NX * NY + NX - 1, -NX * NY + NX,
+    -NX * NY + NX + 1, -NX - 1, -NX, -NX + 1, -1, 0, 1, NX - 1, NX, NX + 1,
+    NX * NY - NX - 1, NX * NY - NX, NX * NY - NX + 1, NX * NY - 1, NX * NY,
+    NX * NY + 1, NX * NY + NX - 1, NX * NY + NX, NX * NY + NX + 1>;
+
+/// \brief collect the distinct diagonal offsets j-i of a csr matrix
+/// \param[in] A input csr matrix
+/// \param[out] offsets sorted distinct offsets
+/// \return \a true if things go wrong, \a false ew
+///
+/// Use this to decide which StencilMatrix instantiation \a A fits into.
+bool detect_offsets(const csr::CSRMatrix &A, std::vector<int> &offsets);
+
+namespace detail {
+
+// rows per block, the slice of y stays in cache across all diagonals
+const int BLOCK = 512;
+
+// position of offset \a off in the pack, -1 if absent
+template <int... Offs>
+inline int find(const int off) {
+  const int offs[] = {Offs...};
+  for (unsigned k = 0; k < sizeof...(Offs); ++k) {
+    if (offs[k] == off) return int(k);
+  }
+  return -1;
+}
+
+// y[lo:hi] += d[lo:hi]*x[lo+Off:hi+Off], clipped to the matrix; y never
+// aliases d or x, so the loop is vectorized without a runtime alias check
+template <int Off>
+inline int apply(const double *__restrict__ d, const double *__restrict__ x,
+                 double *__restrict__ y, const int n, const int lo,
+                 const int hi) {
+  const int b = Off < 0 ? (lo > -Off ? lo : -Off) : lo;
+  const int e = Off > 0 ? (hi < n - Off ? hi : n - Off) : hi;
+#pragma omp simd
+  for (int i = b; i < e; ++i) {
+    y[i] += d[i] * x[i + Off];
+  }
+  return 0;
+}
+
+}  // namespace detail
+
+/// \brief number of stored diagonals
+template <int... Offs>
+inline int stencil_width(const StencilMatrix<Offs...> &) {
+  return int(sizeof...(Offs));
+}
+
+/// \brief create a stencil matrix
+/// \param[in] n row/column size of the squared matrix
+/// \return stencil matrix pointer with zeroed diagonals
+/// \sa destroy
+template <class S>
+S *create(const int n) {
+  S *ptr = nullptr;
+  if (n <= 0) {
+    std::cout << "Invalid matrix shape" << "\n";
+    return ptr;
+  }
+  ptr = new S;
+  ptr->n = n;
+  ptr->value = new double[size_t(n) * stencil_width(*ptr)]();
+  return ptr;
+}
+
+/// \brief destroy a stencil matrix
+/// \param[in] mat stencil matrix that is allocated by create
+template <int... Offs>
+void destroy(StencilMatrix<Offs...> *mat) {
+  if (!mat) return;
+  delete[] mat->value;
+  delete mat;
+}
+
+namespace detail {
+
+// conversion is dispatched on the offsets of S
+template <int... Offs>
+struct Converter {
+  static StencilMatrix<Offs...> *run(const csr::CSRMatrix &A) {
+    const int n = A.n;
+    // check first, so that general matrices are rejected without allocating
+    for (int i = 0; i < n; ++i) {
+      for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+        if (detail::find<Offs...>(A.indices[k] - i) < 0) return nullptr;
+      }
+    }
+    StencilMatrix<Offs...> *S = create<StencilMatrix<Offs...> >(n);
+    if (!S) return nullptr;
+    for (int i = 0; i < n; ++i) {
+      for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+        const int d = detail::find<Offs...>(A.indices[k] - i);
+        S->value[size_t(d) * n + i] += A.value[k];
+      }
+    }
+    return S;
+  }
+};
+
+template <class S>
+struct ConverterOf;
+
+template <int... Offs>
+struct ConverterOf<StencilMatrix<Offs...> > {
+  typedef Converter<Offs...> type;
+};
+
+}  // namespace detail
+
+/// \brief convert a csr matrix if it is an exact stencil
+/// \param[in] A input csr matrix
+/// \return stencil matrix pointer, \a nullptr if an entry of \a A does not
+///         lie on one of the offsets of \a S
+/// \sa detect_offsets
+template <class S>
+S *from_csr(const csr::CSRMatrix &A) {
+  return detail::ConverterOf<S>::type::run(A);
+}
+
+/// \brief matrix vector multiplication
+/// \param[in] A input stencil matrix
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \return  \a true if things go wrong, \a false ew
+///
+/// The loop over the diagonals is unrolled at compile time, each diagonal
+/// is a unit-stride loop with a constant shift of x.
+template <int... Offs>
+bool mv(const StencilMatrix<Offs...> &A, const vec::DenseVec &x,
+        vec::DenseVec &y) {
+  if (x.n != A.n || y.n != A.n) return true;
+  const int n = A.n;
+  const double *xv = x.value;
+  double *yv = y.value;
+
+  for (int lo = 0; lo < n; lo += detail::BLOCK) {
+    const int hi = lo + detail::BLOCK < n ? lo + detail::BLOCK : n;
+    for (int i = lo; i < hi; ++i) {
+      yv[i] = 0.0;
+    }
+    int k = 0;
+    const int unused[] = {
+        detail::apply<Offs>(A.value + size_t(k++) * n, xv, yv, n, lo, hi)...};
+    (void)unused;
+  }
+  return false;
+}
+
+}  // namespace stencil
+
+#endif
@@ -0,0 +1,221 @@
+// This is the source file that contains the implementation of
+// the level-scheduled triangular solves and Gauss-Seidel sweeps
+
+#include "tri.hpp"
+#include "csr.hpp"
+#include "vec.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tri {
+
+// which triangle a sweep solves for
+enum Side { LOWER, UPPER };
+
+// rows per chunk handed out by the sync-free kernels
+static const int SYNC_FREE_CHUNK = 32;
+
+// busy polls of a completion flag before the waiting thread yields
+static const int SPIN_LIMIT = 64;
+
+// bucket the rows by level, returns the number of levels
+static int bucket(const int *level, const int n, int *&ptr, int *&rows) {
+  int nlev = 0;
+  for (int i = 0; i < n; ++i) nlev = std::max(nlev, level[i] + 1);
+
+  ptr = new int[nlev + 1]();
+  rows = new int[n];
+  for (int i = 0; i < n; ++i) ++ptr[level[i] + 1];
+  for (int l = 0; l < nlev; ++l) ptr[l + 1] += ptr[l];
+
+  // rows stay in increasing order within a level
+  int *pos = new int[nlev];
+  std::copy(ptr, ptr + nlev, pos);
+  for (int i = 0; i < n; ++i) rows[pos[level[i]]++] = i;
+  delete[] pos;
+
+  return nlev;
+}
+
+// compute the level sets of a matrix
+Schedule *analyze(const csr::CSRMatrix &A) {
+  const int n = A.n;
+  if (n <= 0) {
+    std::cout << "Invalid matrix shape" << "\n";
+    return nullptr;
+  }
+
+  int *diag = new int[n];
+  for (int i = 0; i < n; ++i) {
+    diag[i] = -1;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      if (A.indices[k] == i) diag[i] = k;
+    }
+    if (diag[i] < 0) {
+      std::cout << "Missing diagonal entry in row " << i << "\n";
+      delete[] diag;
+      return nullptr;
+    }
+  }
+
+  Schedule *s = new Schedule;
+  s->n = n;
+  s->diag = diag;
+
+  // level of row i is one past the deepest row it depends on
+  int *level = new int[n];
+  for (int i = 0; i < n; ++i) {
+    int l = 0;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      const int j = A.indices[k];
+      if (j < i) l = std::max(l, level[j] + 1);
+    }
+    level[i] = l;
+  }
+  s->nlower = bucket(level, n, s->lower_ptr, s->lower_rows);
+
+  for (int i = n - 1; i >= 0; --i) {
+    int l = 0;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      const int j = A.indices[k];
+      if (j > i) l = std::max(l, level[j] + 1);
+    }
+    level[i] = l;
+  }
+  s->nupper = bucket(level, n, s->upper_ptr, s->upper_rows);
+  delete[] level;
+
+  s->flags = new std::atomic<int>[n];
+  s->work = new double[n];
+
+  // a barrier per level does not pay off when levels are narrower than
+  // a couple of rows per thread
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  const int depth = std::max(s->nlower, s->nupper);
+  s->sync_free = n < 2 * threads * depth;
+
+  return s;
+}
+
+// destroy a schedule
+void destroy(Schedule *s) {
+  if (!s) return;
+  delete[] s->lower_ptr;
+  delete[] s->lower_rows;
+  delete[] s->upper_ptr;
+  delete[] s->upper_rows;
+  delete[] s->diag;
+  delete[] s->flags;
+  delete[] s->work;
+  delete s;
+}
+
+// spin until a row is solved, yielding the core after a short spin so
+// that waiting threads do not starve the one they wait on
+static inline void wait_for(const std::atomic<int> &flag) {
+  int spins = 0;
+  while (!flag.load(std::memory_order_acquire)) {
+    if (++spins >= SPIN_LIMIT) {
+      std::this_thread::yield();
+      spins = 0;
+    }
+  }
+}
+
+// solve row i for x[i], rows on the solved side are read from x, the
+// others from old (skipped if old is null)
+static inline void solve_row(const csr::CSRMatrix &A, const int *diag,
+                             const int i, const Side side, const double *b,
+                             double *x, const double *old,
+                             std::atomic<int> *flags) {
+  double sum = b[i];
+  for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+    if (k == diag[i]) continue;
+    const int j = A.indices[k];
+    if (side == LOWER ? j < i : j > i) {
+      if (flags) wait_for(flags[j]);
+      sum -= A.value[k] * x[j];
+    } else if (old) {
+      sum -= A.value[k] * old[j];
+    }
+  }
+  x[i] = sum / A.value[diag[i]];
+  if (flags) flags[i].store(1, std::memory_order_release);
+}
+
+// one triangular sweep
+static void sweep(const csr::CSRMatrix &A, const Schedule &s, const Side side,
+                  const double *b, double *x, const double *old) {
+  const int n = s.n;
+
+  if (s.sync_free) {
+    std::atomic<int> *flags = s.flags;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+      flags[i].store(0, std::memory_order_relaxed);
+    }
+    // chunks are claimed in increasing order from one counter, so every
+    // row a chunk waits on has already been claimed by a running thread
+    std::atomic<int> next(0);
+#pragma omp parallel
+    for (;;) {
+      const int first = next.fetch_add(SYNC_FREE_CHUNK);
+      if (first >= n) break;
+      const int last = std::min(n, first + SYNC_FREE_CHUNK);
+      for (int p = first; p < last; ++p) {
+        const int i = side == LOWER ? p : n - 1 - p;
+        solve_row(A, s.diag, i, side, b, x, old, flags);
+      }
+    }
+    return;
+  }
+
+  const int *ptr = side == LOWER ? s.lower_ptr : s.upper_ptr;
+  const int *rows = side == LOWER ? s.lower_rows : s.upper_rows;
+  const int nlev = side == LOWER ? s.nlower : s.nupper;
+#pragma omp parallel
+  for (int l = 0; l < nlev; ++l) {
+#pragma omp for schedule(static)
+    for (int p = ptr[l]; p < ptr[l + 1]; ++p) {
+      solve_row(A, s.diag, rows[p], side, b, x, old, nullptr);
+    }
+  }
+}
+
+// lower triangular solve
+bool lsolve(const csr::CSRMatrix &A, const Schedule &s,
+            const vec::DenseVec &b, vec::DenseVec &x) {
+  if (A.n != s.n || b.n != s.n || x.n != s.n) return true;
+  sweep(A, s, LOWER, b.value, x.value, nullptr);
+  return false;
+}
+
+// upper triangular solve
+bool usolve(const csr::CSRMatrix &A, const Schedule &s,
+            const vec::DenseVec &b, vec::DenseVec &x) {
+  if (A.n != s.n || b.n != s.n || x.n != s.n) return true;
+  sweep(A, s, UPPER, b.value, x.value, nullptr);
+  return false;
+}
+
+// one symmetric Gauss-Seidel sweep
+bool sgs(const csr::CSRMatrix &A, const Schedule &s, const vec::DenseVec &b,
+         vec::DenseVec &x) {
+  if (A.n != s.n || b.n != s.n || x.n != s.n) return true;
+  std::copy(x.value, x.value + s.n, s.work);
+  sweep(A, s, LOWER, b.value, x.value, s.work);
+  std::copy(x.value, x.value + s.n, s.work);
+  sweep(A, s, UPPER, b.value, x.value, s.work);
+  return false;
+}
+
+}  // namespace tri
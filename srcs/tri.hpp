@@ -0,0 +1,99 @@
+// This is part of AMS562 midterm project
+
+/// \brief Sparse triangular solves and Gauss-Seidel sweeps on CSR
+
+#ifndef _TRI_HPP
+#define _TRI_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// declaration
+namespace vec {
+template <typename I>
+struct DenseVecT;
+typedef DenseVecT<std::int32_t> DenseVec;
+}
+
+namespace csr {
+template <typename I>
+struct CSRMatrixT;
+typedef CSRMatrixT<std::int32_t> CSRMatrix;
+}
+
+namespace tri {
+
+/// \struct Schedule
+/// \brief cached level sets of the lower and upper dependency DAGs
+///
+/// Rows in the same level do not depend on each other and are processed in
+/// parallel, with a barrier between levels. For deep DAGs (few rows per
+/// level) the sync-free kernels are used instead, where each row waits on
+/// per-row completion flags of the rows it depends on. The flags and the
+/// sweep buffer are written by every solve, so a schedule must not be
+/// shared by concurrent calls; analyze one schedule per thread instead.
+struct Schedule {
+  int *lower_ptr;           ///< level pointer of the lower DAG
+  int *lower_rows;          ///< rows sorted by lower level
+  int nlower;               ///< number of lower levels
+  int *upper_ptr;           ///< level pointer of the upper DAG
+  int *upper_rows;          ///< rows sorted by upper level
+  int nupper;               ///< number of upper levels
+  int *diag;                ///< position of the diagonal entry in each row
+  std::atomic<int> *flags;  ///< completion flags of the sync-free kernels
+  double *work;             ///< previous iterate of the Gauss-Seidel sweeps
+  bool sync_free;           ///< \a true to use the sync-free kernels
+  int n;                    ///< size of the square matrix
+};
+
+/// \brief compute the level sets of a matrix
+/// \param[in] A input csr matrix with a non-zero diagonal
+/// \return schedule pointer, \a nullptr if a diagonal entry is missing
+/// \sa destroy
+Schedule *analyze(const csr::CSRMatrix &A);
+
+/// \brief destroy a schedule
+/// \param[in] s schedule that is allocated by analyze
+void destroy(Schedule *s);
+
+/// \brief lower triangular solve
+/// \param[in] A input csr matrix, only its lower part and diagonal are used
+/// \param[in] s schedule of \a A
+/// \param[in] b input rhs vector
+/// \param[out] x solution of (D+L)x=b
+/// \return \a true if things go wrong, \a false ew
+///
+/// The sync-free kernel resets and sets the flags of \a s, so the schedule
+/// must not be shared by concurrent calls.
+bool lsolve(const csr::CSRMatrix &A, const Schedule &s,
+            const vec::DenseVec &b, vec::DenseVec &x);
+
+/// \brief upper triangular solve
+/// \param[in] A input csr matrix, only its upper part and diagonal are used
+/// \param[in] s schedule of \a A
+/// \param[in] b input rhs vector
+/// \param[out] x solution of (D+U)x=b
+/// \return \a true if things go wrong, \a false ew
+///
+/// The sync-free kernel resets and sets the flags of \a s, so the schedule
+/// must not be shared by concurrent calls.
+bool usolve(const csr::CSRMatrix &A, const Schedule &s,
+            const vec::DenseVec &b, vec::DenseVec &x);
+
+/// \brief one symmetric Gauss-Seidel sweep
+/// \param[in] A input csr matrix
+/// \param[in] s schedule of \a A
+/// \param[in] b input rhs vector
+/// \param[in,out] x current iterate, updated by a forward then a backward
+///                sweep
+/// \return \a true if things go wrong, \a false ew
+///
+/// The result is identical to the serial sweep in natural row order. The
+/// schedule holds the sweep buffers, so it must not be shared by concurrent
+/// calls.
+bool sgs(const csr::CSRMatrix &A, const Schedule &s, const vec::DenseVec &b,
+         vec::DenseVec &x);
+
+}  // namespace tri
+
+#endif
@@ -0,0 +1,428 @@
+// This is the source file that contains the implementation of
+// the auto-tuner and its kernel candidates
+
+#include "tune.hpp"
+#include "coo.hpp"
+#include "csr.hpp"
+#include "stencil.hpp"
+#include "vec.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tune {
+
+// candidate kernels
+
+// plain csr, works directly on the input matrix
+static void *prepare_csr(const csr::CSRMatrix &A) {
+  return const_cast<csr::CSRMatrix *>(&A);
+}
+
+static bool mv_csr(const void *data, const vec::DenseVec &x,
+                   vec::DenseVec &y) {
+  return csr::mv(*static_cast<const csr::CSRMatrix *>(data), x, y);
+}
+
+static void release_csr(void *) {}
+
+// threaded csr kernels on the input matrix
+static bool mv_csr_merge(const void *data, const vec::DenseVec &x,
+                         vec::DenseVec &y) {
+  return csr::mv_merge(*static_cast<const csr::CSRMatrix *>(data), x, y);
+}
+
+// adaptive csr keeps its row bins next to the matrix
+struct Adaptive {
+  const csr::CSRMatrix *A;
+  csr::RowBins *bins;
+};
+
+static void *prepare_adaptive(const csr::CSRMatrix &A) {
+  csr::RowBins *bins = csr::bin_rows(A);
+  if (!bins) return nullptr;
+  Adaptive *a = new Adaptive;
+  a->A = &A;
+  a->bins = bins;
+  return a;
+}
+
+static bool mv_csr_adaptive(const void *data, const vec::DenseVec &x,
+                            vec::DenseVec &y) {
+  const Adaptive *a = static_cast<const Adaptive *>(data);
+  return csr::mv_adaptive(*a->A, *a->bins, x, y);
+}
+
+static void release_adaptive(void *data) {
+  Adaptive *a = static_cast<Adaptive *>(data);
+  csr::destroy(a->bins);
+  delete a;
+}
+
+// coo copy of the input matrix
+static void *prepare_coo(const csr::CSRMatrix &A) {
+  const int nnz = A.indptr[A.n];
+  coo::COOMatrix *m = coo::create(A.n, nnz);
+  if (!m) return nullptr;
+  for (int i = 0; i < A.n; ++i) {
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      coo::assign_ijv(*m, i, A.indices[k], A.value[k], k);
+    }
+  }
+  return m;
+}
+
+static bool mv_coo(const void *data, const vec::DenseVec &x,
+                   vec::DenseVec &y) {
+  return coo::mv(*static_cast<const coo::COOMatrix *>(data), x, y);
+}
+
+static void release_coo(void *data) {
+  coo::destroy(static_cast<coo::COOMatrix *>(data));
+}
+
+// tridiagonal stencil, only prepared when the matrix fits exactly
+typedef stencil::StencilMatrix<-1, 0, 1> Tridiag;
+
+static void *prepare_dia3(const csr::CSRMatrix &A) {
+  return stencil::from_csr<Tridiag>(A);
+}
+
+static bool mv_dia3(const void *data, const vec::DenseVec &x,
+                    vec::DenseVec &y) {
+  return stencil::mv(*static_cast<const Tridiag *>(data), x, y);
+}
+
+static void release_dia3(void *data) {
+  stencil::destroy(static_cast<Tridiag *>(data));
+}
+
+/// \struct Kernel
+/// \brief a candidate in the tuning space
+struct Kernel {
+  const char *name;                                ///< database key
+  void *(*prepare)(const csr::CSRMatrix &A);       ///< build kernel data
+  bool (*mv)(const void *data, const vec::DenseVec &x, vec::DenseVec &y);
+  void (*release)(void *data);                     ///< free kernel data
+  bool threaded;                                   ///< uses OpenMP threads
+};
+
+static const Kernel KERNELS[] = {
+    {"csr", prepare_csr, mv_csr, release_csr, false},
+    {"coo", prepare_coo, mv_coo, release_coo, false},
+    {"dia3", prepare_dia3, mv_dia3, release_dia3, false},
+    {"csr_merge", prepare_csr, mv_csr_merge, release_csr, true},
+    {"csr_adaptive", prepare_adaptive, mv_csr_adaptive, release_adaptive,
+     true},
+};
+
+static const int NUM_KERNELS = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+// below this many non-zeros a single product is cheaper than timing it
+static const int BENCH_MIN_NNZ = 1 << 14;
+
+// smallest fill ratio at which blocks larger than 1x1 are reported
+static const double BLOCK_FILL_MIN = 2.0 / 3.0;
+
+/// \struct Plan
+/// \brief tuned kernel bound to one matrix
+struct Plan {
+  const csr::CSRMatrix *A;  ///< input matrix
+  int kernel;               ///< index into KERNELS
+  int threads;              ///< thread count of the kernel
+  void *data;               ///< kernel data built by prepare
+};
+
+// row length and bandwidth statistics, the only ones predict reads
+static void row_stats(const csr::CSRMatrix &A, Stats &s) {
+  const int n = A.n;
+  const int nnz = A.indptr[n];
+
+  s.n = n;
+  s.nnz = nnz;
+  s.row_min = nnz;
+  s.row_max = 0;
+  s.bandwidth = 0;
+
+  double sum2 = 0.0;
+  for (int i = 0; i < n; ++i) {
+    const int len = A.indptr[i + 1] - A.indptr[i];
+    s.row_min = std::min(s.row_min, len);
+    s.row_max = std::max(s.row_max, len);
+    sum2 += double(len) * len;
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      s.bandwidth = std::max(s.bandwidth, std::abs(A.indices[k] - i));
+    }
+  }
+  s.row_mean = double(nnz) / n;
+  s.row_std = std::sqrt(std::max(0.0, sum2 / n - s.row_mean * s.row_mean));
+}
+
+// compute the structural statistics
+bool analyze(const csr::CSRMatrix &A, Stats &s) {
+  if (A.n <= 0) return true;
+  row_stats(A, s);
+  const int n = A.n;
+  const int nnz = A.indptr[n];
+
+  // rows are not required to be sorted, so sort a copy of the columns
+  std::vector<int> cols(A.indices, A.indices + nnz);
+  for (int i = 0; i < n; ++i) {
+    std::sort(cols.begin() + A.indptr[i], cols.begin() + A.indptr[i + 1]);
+  }
+
+  // pattern symmetry, every (i,j) must have a matching (j,i)
+  s.symmetric = true;
+  for (int i = 0; i < n && s.symmetric; ++i) {
+    for (int k = A.indptr[i]; k < A.indptr[i + 1]; ++k) {
+      const int j = cols[k];
+      if (!std::binary_search(cols.begin() + A.indptr[j],
+                              cols.begin() + A.indptr[j + 1], i)) {
+        s.symmetric = false;
+        break;
+      }
+    }
+  }
+
+  // block structure, count the non-empty bxb blocks for a few sizes; 1x1
+  // blocks are always full, a larger size must reach BLOCK_FILL_MIN to win
+  s.block_size = 1;
+  s.block_fill = 1.0;
+  double best = BLOCK_FILL_MIN;
+  std::vector<int> bcols;
+  for (int b = 2; b <= 4; ++b) {
+    long long blocks = 0;
+    for (int bi = 0; bi * b < n; ++bi) {
+      bcols.clear();
+      const int last = std::min(n, (bi + 1) * b);
+      for (int k = A.indptr[bi * b]; k < A.indptr[last]; ++k) {
+        bcols.push_back(cols[k] / b);
+      }
+      std::sort(bcols.begin(), bcols.end());
+      blocks += std::unique(bcols.begin(), bcols.end()) - bcols.begin();
+    }
+    const double fill = blocks ? double(nnz) / (double(blocks) * b * b) : 0.0;
+    if (fill >= best) {
+      best = fill;
+      s.block_size = b;
+      s.block_fill = fill;
+    }
+  }
+
+  return false;
+}
+
+// FNV-1a over the sparsity pattern
+unsigned long long fingerprint(const csr::CSRMatrix &A) {
+  unsigned long long h = 14695981039346656037ULL;
+  const unsigned long long prime = 1099511628211ULL;
+  const int n = A.n;
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(&n);
+  for (unsigned k = 0; k < sizeof(int); ++k) h = (h ^ p[k]) * prime;
+  p = reinterpret_cast<const unsigned char *>(A.indptr);
+  for (size_t k = 0; k < sizeof(int) * (n + 1); ++k) h = (h ^ p[k]) * prime;
+  p = reinterpret_cast<const unsigned char *>(A.indices);
+  for (size_t k = 0; k < sizeof(int) * size_t(A.indptr[n]); ++k) {
+    h = (h ^ p[k]) * prime;
+  }
+  return h;
+}
+
+// find a kernel by database name, -1 if unknown
+static int find_kernel(const std::string &name) {
+  for (int k = 0; k < NUM_KERNELS; ++k) {
+    if (name == KERNELS[k].name) return k;
+  }
+  return -1;
+}
+
+// look up a fingerprint in the database
+static bool db_lookup(const char *db_file, unsigned long long key,
+                      int &kernel, int &threads) {
+  if (!db_file) return false;
+  std::ifstream f(db_file);
+  if (!f.is_open()) return false;
+  std::string line, name;
+  unsigned long long k;
+  int t;
+  while (std::getline(f, line)) {
+    std::istringstream ss(line);
+    if (!(ss >> std::hex >> k >> std::dec >> name >> t)) continue;
+    if (k != key) continue;
+    const int idx = find_kernel(name);
+    if (idx < 0 || t <= 0) continue;  // stale entry from another build
+    kernel = idx;
+    threads = t;
+  }
+  return kernel >= 0;
+}
+
+// append a decision to the database
+static void db_store(const char *db_file, unsigned long long key, int kernel,
+                     int threads) {
+  if (!db_file) return;
+  std::ofstream f(db_file, std::ios::app);
+  if (!f.is_open()) {
+    std::cerr << "cannot open tuning database " << db_file << '\n';
+    return;
+  }
+  f << std::hex << key << std::dec << ' ' << KERNELS[kernel].name << ' '
+    << threads << '\n';
+}
+
+// a few rows dominate, which only the threaded kernels can balance, so
+// the choice is left to timing even for small matrices
+static bool skewed(const Stats &s) {
+  return s.row_max > 16 * (s.row_mean + 1.0);
+}
+
+// pick a kernel from the statistics alone, for matrices that are not skewed
+static int predict(const Stats &s) {
+  // no index loads at all
+  if (s.bandwidth <= 1) return find_kernel("dia3");
+  return find_kernel("csr");
+}
+
+// largest useful thread count
+static int max_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// run a kernel with the given thread count, the caller's setting is kept
+static bool run(const Kernel &kern, const void *data, const int threads,
+                const vec::DenseVec &x, vec::DenseVec &y) {
+#ifdef _OPENMP
+  if (kern.threaded) {
+    const int saved = omp_get_max_threads();
+    omp_set_num_threads(threads);
+    const bool fail = kern.mv(data, x, y);
+    omp_set_num_threads(saved);
+    return fail;
+  }
+#endif
+  (void)threads;
+  return kern.mv(data, x, y);
+}
+
+// best-of timing of one prepared kernel
+static double bench(const Kernel &kern, const void *data, const int threads,
+                    const vec::DenseVec &x, vec::DenseVec &y) {
+  typedef std::chrono::steady_clock clock;
+  run(kern, data, threads, x, y);  // warm up
+  double best = 1e300, total = 0.0;
+  for (int rep = 0; rep < 50 && (rep < 3 || total < 5e-3); ++rep) {
+    const clock::time_point t0 = clock::now();
+    if (run(kern, data, threads, x, y)) return 1e300;
+    const double t = std::chrono::duration<double>(clock::now() - t0).count();
+    best = std::min(best, t);
+    total += t;
+  }
+  return best;
+}
+
+// select the fastest kernel
+Plan *create(const csr::CSRMatrix &A, const char *db_file) {
+  if (A.n <= 0) {
+    std::cout << "Invalid matrix shape" << "\n";
+    return nullptr;
+  }
+
+  // a database hit needs nothing but the fingerprint
+  const unsigned long long key = fingerprint(A);
+  int kernel = -1, threads = 1;
+
+  if (!db_lookup(db_file, key, kernel, threads)) {
+    const int n = A.n;
+    Stats s;
+    const bool small = A.indptr[n] < BENCH_MIN_NNZ;
+    if (small) row_stats(A, s);
+    if (small && !skewed(s)) {
+      kernel = predict(s);
+    } else {
+      vec::DenseVec *x = vec::create(n);
+      vec::DenseVec *y = vec::create(n);
+      for (int i = 0; i < n; ++i) x->value[i] = 1.0;
+      double best = 1e300;
+      // powers of two below the available threads, and all of them
+      std::vector<int> counts;
+      for (int t = 1; t < max_threads(); t *= 2) counts.push_back(t);
+      counts.push_back(max_threads());
+
+      for (int k = 0; k < NUM_KERNELS; ++k) {
+        void *data = KERNELS[k].prepare(A);
+        if (!data) continue;
+        for (unsigned c = 0; c < counts.size(); ++c) {
+          if (c > 0 && !KERNELS[k].threaded) break;
+          const double time = bench(KERNELS[k], data, counts[c], *x, *y);
+          if (time < best) {
+            best = time;
+            kernel = k;
+            threads = counts[c];
+          }
+        }
+        KERNELS[k].release(data);
+      }
+      vec::destroy(x);
+      vec::destroy(y);
+      if (kernel < 0) kernel = find_kernel("csr");
+    }
+    db_store(db_file, key, kernel, threads);
+  }
+
+  void *data = KERNELS[kernel].prepare(A);
+  if (!data) {
+    std::cout << "Allocation failed" << "\n";
+    return nullptr;
+  }
+
+  Plan *plan = new Plan;
+  plan->A = &A;
+  plan->kernel = kernel;
+  plan->threads = threads;
+  plan->data = data;
+  return plan;
+}
+
+// rebuild the kernel data after the values of the matrix changed
+bool update(Plan &plan) {
+  const Kernel &kern = KERNELS[plan.kernel];
+  void *data = kern.prepare(*plan.A);
+  if (!data) return true;  // the pattern no longer fits the kernel
+  kern.release(plan.data);
+  plan.data = data;
+  return false;
+}
+
+// destroy a plan
+void destroy(Plan *plan) {
+  if (!plan) return;
+  KERNELS[plan->kernel].release(plan->data);
+  delete plan;
+}
+
+const char *kernel_name(const Plan &plan) { return KERNELS[plan.kernel].name; }
+
+int threads(const Plan &plan) { return plan.threads; }
+
+// matrix vector multiplication with the selected kernel
+bool mv(const Plan &plan, const vec::DenseVec &x, vec::DenseVec &y) {
+  if (x.n != plan.A->n || y.n != plan.A->n) return true;
+  return run(KERNELS[plan.kernel], plan.data, plan.threads, x, y);
+}
+
+}  // namespace tune
@@ -0,0 +1,105 @@
+// This is part of AMS562 midterm project
+
+/// \brief Auto-tuner that selects the storage format and kernel per matrix
+
+#ifndef _TUNE_HPP
+#define _TUNE_HPP
+
+#include <cstdint>
+
+// declaration
+namespace vec {
+template <typename I>
+struct DenseVecT;
+typedef DenseVecT<std::int32_t> DenseVec;
+}
+
+namespace csr {
+template <typename I>
+struct CSRMatrixT;
+typedef CSRMatrixT<std::int32_t> CSRMatrix;
+}
+
+namespace tune {
+
+/// \struct Stats
+/// \brief structural statistics of a csr matrix
+struct Stats {
+  int n;            ///< size of the square matrix
+  int nnz;          ///< total number of non-zeros
+  int row_min;      ///< shortest row length
+  int row_max;      ///< longest row length
+  double row_mean;  ///< average row length
+  double row_std;   ///< standard deviation of the row lengths
+  int bandwidth;    ///< max |i-j| over all non-zeros
+  int block_size;   ///< largest block size (1 to 4) with the best fill
+                    ///< ratio, 1 unless a larger size fills 2/3 of its blocks
+  double block_fill;  ///< fill ratio of the non-empty blocks of block_size
+  bool symmetric;   ///< \a true if the sparsity pattern is symmetric
+};
+
+/// \brief compute the structural statistics of a matrix
+/// \param[in] A input csr matrix
+/// \param[out] s statistics
+/// \return \a true if things go wrong, \a false ew
+bool analyze(const csr::CSRMatrix &A, Stats &s);
+
+/// \brief hash the sparsity pattern of a matrix
+/// \param[in] A input csr matrix
+/// \return 64-bit fingerprint of n, indptr and indices
+///
+/// Values are not hashed, so matrices that share a pattern share a plan.
+unsigned long long fingerprint(const csr::CSRMatrix &A);
+
+/// \struct Plan
+/// \brief opaque handle of the tuned kernel for one matrix
+struct Plan;
+
+/// \brief select the fastest kernel for a matrix
+/// \param[in] A input csr matrix, must outlive the plan
+/// \param[in] db_file tuning database file, can be \a nullptr
+/// \return plan pointer, \a nullptr if things go wrong
+/// \sa destroy
+///
+/// The database is looked up by fingerprint first, so a hit costs one pass
+/// over the pattern. On a miss, the kernel is either predicted from the row
+/// statistics (small matrices) or timed, and the decision is appended to
+/// \a db_file. Small matrices whose rows are very uneven are timed too.
+/// Threaded kernels are timed at power-of-two thread counts up to the
+/// OpenMP maximum.
+///
+/// The csr kernels read \a A on every product, but the coo and dia3 kernels
+/// copy its values here. Call update after changing \a A.value in place.
+Plan *create(const csr::CSRMatrix &A, const char *db_file);
+
+/// \brief refresh the kernel data from the current values of the matrix
+/// \param[in,out] plan tuned plan
+/// \return \a true if things go wrong, \a false ew
+///
+/// The pattern of the matrix must not have changed since create.
+bool update(Plan &plan);
+
+/// \brief destroy a plan
+/// \param[in] plan plan that is allocated by create
+void destroy(Plan *plan);
+
+/// \brief name of the selected kernel
+/// \param[in] plan tuned plan
+const char *kernel_name(const Plan &plan);
+
+/// \brief thread count of the selected kernel
+/// \param[in] plan tuned plan
+int threads(const Plan &plan);
+
+/// \brief matrix vector multiplication with the selected kernel
+/// \param[in] plan tuned plan
+/// \param[in] x input rhs vector
+/// \param[out] y output lhs vector
+/// \return  \a true if things go wrong, \a false ew
+///
+/// Uses the values of the matrix as of the last create or update.
+bool mv(const Plan &plan, const vec::DenseVec &x, vec::DenseVec &y);
+
+}  // namespace tune
+
+#endif
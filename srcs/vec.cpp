@@ -1,21 +1,28 @@
 // This is the source file that contains the implementation of
 // DenseVec and its corresponding functions
 
-// You should not touch this file!
-
 #include "vec.hpp"
 
+#include <cstddef>
+#include <limits>
+
 namespace vec {
 
 // create a vector
-DenseVec *create(const int n) {
-  DenseVec *ptr = nullptr;
+template <typename I>
+DenseVecT<I> *create(const I n) {
+  DenseVecT<I> *ptr = nullptr;
   if (n <= 0) {
     // invalid size, return nullptr
     return ptr;
   }
+  if (static_cast<unsigned long long>(n) >
+      std::numeric_limits<std::size_t>::max() / sizeof(double)) {
+    // the byte count of the value array does not fit
+    return ptr;
+  }
   // first allocate a pointer that points to DenseVec
-  ptr = new DenseVec;
+  ptr = new DenseVecT<I>;
 
   // allocation failed
   if (!ptr) {
@@ -38,7 +45,8 @@ DenseVec *create(const int n) {
 }
 
 // destroy a vector
-void destroy(DenseVec *vec) {
+template <typename I>
+void destroy(DenseVecT<I> *vec) {
   if (!vec) {
     // if the pointer is null, direct return, do nothing
     return;
@@ -53,4 +61,10 @@ void destroy(DenseVec *vec) {
   delete vec;
 }
 
+// instantiations
+template DenseVecT<std::int32_t> *create(const std::int32_t n);
+template DenseVecT<std::int64_t> *create(const std::int64_t n);
+template void destroy(DenseVecT<std::int32_t> *vec);
+template void destroy(DenseVecT<std::int64_t> *vec);
+
 }  // namespace vec
@@ -5,24 +5,39 @@
 #ifndef _VEC_HPP
 #define _VEC_HPP
 
+#include <cstdint>
+
 namespace vec {
 
-/// \struct DenseVec
+/// \struct DenseVecT
 /// \brief representation of dense vector
-struct DenseVec {
-  double *value;  ///< data array
-  int n;          ///< length of the vector
+/// \tparam I index type, std::int32_t or std::int64_t
+template <typename I>
+struct DenseVecT {
+  typedef I index_type;  ///< type of the length
+  double *value;         ///< data array
+  I n;                   ///< length of the vector
 };
 
+/// \brief vector with 32-bit length
+typedef DenseVecT<std::int32_t> DenseVec;
+
+/// \brief vector with 64-bit length
+typedef DenseVecT<std::int64_t> DenseVec64;
+
 /// \brief create a vector
 /// \param[in] n size of the vector
+/// \return vector pointer, \a nullptr if \a n is not positive or the
+///         allocation size overflows
 /// \note The implementation is in vec.cpp
-DenseVec *create(const int n);
+template <typename I>
+DenseVecT<I> *create(const I n);
 
 /// \brief destroy a vector
 /// \param[in] vec input vector
 /// \note The implementation is in vec.cpp
-void destroy(DenseVec *vec);
+template <typename I>
+void destroy(DenseVecT<I> *vec);
 
 }  // namespace vec
 
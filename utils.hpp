@@ -3,6 +3,7 @@
 #ifndef _AMS562_PROJ1_UTILS_HPP
 #define _AMS562_PROJ1_UTILS_HPP
 
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -10,11 +11,18 @@
 
 #include "srcs/coo.hpp"
 #include "srcs/csr.hpp"
+#include "srcs/mmio.hpp"
+#include "srcs/mpir.hpp"
+#include "srcs/pool.hpp"
+#include "srcs/stencil.hpp"
+#include "srcs/tri.hpp"
+#include "srcs/tune.hpp"
 #include "srcs/vec.hpp"
 
 namespace utils {
 // load the vector size
-inline int load_vec_size(const std::string &filename) {
+template <typename I = std::int32_t>
+inline I load_vec_size(const std::string &filename) {
   std::ifstream f(filename.c_str());
   if (!f.is_open()) {
     std::cerr << "cannot open file " << filename << ", aborting...\n";
@@ -22,13 +30,20 @@ inline int load_vec_size(const std::string &filename) {
               << ", in file:" << __FILE__ << "\n";
     std::exit(1);
   }
-  int n;
-  f >> n;
+  // extraction fails if the size does not fit in I
+  I n;
+  if (!(f >> n)) {
+    std::cerr << "vector size is invalid or overflows, aborting...\n";
+    std::cerr << "error occured at line:" << __LINE__
+              << ", in file:" << __FILE__ << "\n";
+    std::exit(1);
+  }
   return n;
 }
 
 // load an array to DenseVec
-inline void load_vec(const std::string &filename, vec::DenseVec &v) {
+template <typename I>
+inline void load_vec(const std::string &filename, vec::DenseVecT<I> &v) {
   std::ifstream f(filename.c_str());
   if (!f.is_open()) {
     std::cerr << "cannot open file " << filename << ", aborting...\n";
@@ -36,9 +51,8 @@ inline void load_vec(const std::string &filename, vec::DenseVec &v) {
               << ", in file:" << __FILE__ << "\n";
     std::exit(1);
   }
-  int n;
-  f >> n;
-  if (n != v.n) {
+  I n;
+  if (!(f >> n) || n != v.n) {
     std::cerr << "vector sizes don\'t match, aborting...\n";
     std::cerr << "error occured at line:" << __LINE__
               << ", in file:" << __FILE__ << "\n";
@@ -47,7 +61,7 @@ inline void load_vec(const std::string &filename, vec::DenseVec &v) {
 
   // now, assign values
   double buffer;
-  for (int i = 0; i < n; ++i) {
+  for (I i = 0; i < n; ++i) {
     f >> buffer;  // read a double into buffer
     v.value[i] = buffer;
   }
@@ -57,7 +71,8 @@ inline void load_vec(const std::string &filename, vec::DenseVec &v) {
 }
 
 // get the size and nnz of a sparse matrix that is stored in file
-inline void load_mat_sizes(const std::string &filename, int &n, int &nnz) {
+template <typename I>
+inline void load_mat_sizes(const std::string &filename, I &n, I &nnz) {
   std::ifstream f(filename.c_str());
   if (!f.is_open()) {
     std::cerr << "cannot open file " << filename << ", aborting...\n";
@@ -66,15 +81,21 @@ inline void load_mat_sizes(const std::string &filename, int &n, int &nnz) {
     std::exit(1);
   }
 
-  // extract n and nnz
-  f >> n >> nnz;
+  // extract n and nnz, extraction fails if they do not fit in I
+  if (!(f >> n >> nnz)) {
+    std::cerr << "matrix sizes are invalid or overflow, aborting...\n";
+    std::cerr << "error occured at line:" << __LINE__
+              << ", in file:" << __FILE__ << "\n";
+    std::exit(1);
+  }
 
   // close file
   f.close();
 }
 
 // load an sparse matrix with coo to COOMatrix
-inline void load_coo(const std::string &filename, coo::COOMatrix &m) {
+template <typename I>
+inline void load_coo(const std::string &filename, coo::COOMatrixT<I> &m) {
   std::ifstream f(filename.c_str());
   if (!f.is_open()) {
     std::cerr << "cannot open file " << filename << ", aborting...\n";
@@ -83,9 +104,8 @@ inline void load_coo(const std::string &filename, coo::COOMatrix &m) {
     std::exit(1);
   }
   // extract n and nnz
-  int n, nnz;
-  f >> n >> nnz;
-  if (m.n != n || m.nnz != nnz) {
+  I n, nnz;
+  if (!(f >> n >> nnz) || m.n != n || m.nnz != nnz) {
     std::cerr << "COOMatrix sizes don\'t match, aborting...\n";
     std::cerr << "error occured at line:" << __LINE__
               << ", in file:" << __FILE__ << "\n";
@@ -93,13 +113,13 @@ inline void load_coo(const std::string &filename, coo::COOMatrix &m) {
   }
 
   // create buffer
-  int i, j;
+  I i, j;
   double v;
-  for (int k = 0; k < nnz; ++k) {
-    f >> i >> j >> v;  // load values from file
-    if (coo::assign_ijv(m, i, j, v, k)) {
-      std::cerr << "COOMatrix failed to assign (i,j,v)=(" << i << ',' << j
-                << ',' << v << "), aborting...\n";
+  for (I k = 0; k < nnz; ++k) {
+    // load values from file, out of range indices are rejected below
+    if (!(f >> i >> j >> v) || coo::assign_ijv(m, i, j, v, k)) {
+      std::cerr << "COOMatrix failed to assign entry " << k
+                << ", aborting...\n";
       std::cerr << "error occured at line:" << __LINE__
                 << ", in file:" << __FILE__ << "\n";
       std::exit(1);
@@ -114,7 +134,8 @@ inline void load_coo(const std::string &filename, coo::COOMatrix &m) {
 
 
 // load an sparse matrix with coo and convert it to csr
-inline void load_csr(const std::string &filename, csr::CSRMatrix &m) {
+template <typename I>
+inline void load_csr(const std::string &filename, csr::CSRMatrixT<I> &m) {
   std::ifstream f(filename.c_str());
   if (!f.is_open()) {
     std::cerr << "cannot open file " << filename << ", aborting...\n";
@@ -123,9 +144,9 @@ inline void load_csr(const std::string &filename, csr::CSRMatrix &m) {
     std::exit(1);
   }
   // extract n and nnz
-  int n, nnz;
-  f >> n >> nnz;
-  if (m.n != n) {
+  I n, nnz;
+  // the file must fit in the allocated entries
+  if (!(f >> n >> nnz) || m.n != n || nnz > m.nnz) {
     std::cerr << "CSRMatrix sizes don\'t match, aborting...\n";
     std::cerr << "error occured at line:" << __LINE__
               << ", in file:" << __FILE__ << "\n";
@@ -133,21 +154,47 @@ inline void load_csr(const std::string &filename, csr::CSRMatrix &m) {
   }
 
   // local construction buffers
-  std::vector<int> inds;
+  std::vector<I> inds;
   std::vector<double> vs;
   
-  int i, j;
+  I i, j;
   double v;
-  int start = 0;
-  for (int k = 0; k < nnz; ++k) {
-    f >> i >> j >> v;  // load values from file
+  I start = 0;
+  for (I k = 0; k < nnz; ++k) {
+    // load values from file, rows must be sorted and indices in range
+    if (!(f >> i >> j >> v) || i < start || i >= n || j < 0 || j >= n) {
+      std::cerr << "CSRMatrix failed to read entry " << k
+                << ", aborting...\n";
+      std::cerr << "error occured at line:" << __LINE__
+                << ", in file:" << __FILE__ << "\n";
+      std::exit(1);
+    }
     if (start == i) {
       inds.push_back(j);
       vs.push_back(v);
       continue;
     }
 
-    // finish a row
+    // finish a row, and any empty rows before the next one
+    for (; start < i; ++start) {
+      if (csr::assign_row(m, start, inds.data(), vs.data(), inds.size())) {
+        std::cerr << "CSRMatrix failed to assign row=" << start
+                  << ", aborting...\n";
+        std::cerr << "error occured at line:" << __LINE__
+                  << ", in file:" << __FILE__ << "\n";
+        std::exit(1);
+      }
+      inds.clear();
+      vs.clear();
+    }
+
+    // i, j, v store the first entry of next row
+    inds.push_back(j);
+    vs.push_back(v);
+  }
+
+  // finish the last row, and any empty rows after it
+  for (; start < n; ++start) {
     if (csr::assign_row(m, start, inds.data(), vs.data(), inds.size())) {
       std::cerr << "CSRMatrix failed to assign row=" << start
                 << ", aborting...\n";
@@ -155,22 +202,8 @@ inline void load_csr(const std::string &filename, csr::CSRMatrix &m) {
                 << ", in file:" << __FILE__ << "\n";
       std::exit(1);
     }
-
-    // i, j, v store the first entry of next row
-    ++start;
     inds.clear();
     vs.clear();
-    inds.push_back(j);
-    vs.push_back(v);
-  }
-
-  // finish the last row
-  if (csr::assign_row(m, start, inds.data(), vs.data(), inds.size())) {
-    std::cerr << "CSRMatrix failed to assign row=" << start
-              << ", aborting...\n";
-    std::cerr << "error occured at line:" << __LINE__
-              << ", in file:" << __FILE__ << "\n";
-    std::exit(1);
   }
   
   // close file